@@ -0,0 +1,183 @@
+/**
+ * ROKOR_Mesh_FLP - Пример Batching_Benchmark
+ *
+ * Этот скетч сравнивает отправку мелких сообщений с объединением в кадры (setBatching)
+ * и без него. Загрузите его на два устройства с одинаковым именем сети:
+ * одно станет Шлюзом, другое - Узлом.
+ *
+ * Узел поочередно (по TEST_PHASE_MS) включает и выключает объединение и непрерывно
+ * ставит в очередь 12-байтовые "показания". По итогам каждой фазы выводятся:
+ *   - доставленных сообщений в секунду (по TX_STATUS_ACK);
+ *   - число кадров ESP-NOW на одно сообщение;
+ *   - оценка эфирного времени на одно сообщение.
+ * Шлюз раз в секунду выводит число принятых сообщений.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "BatchBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint32_t TEST_PHASE_MS = 10000;
+const uint8_t READING_SIZE = 12;
+const uint32_t BATCH_WINDOW_MS = 20;
+
+// Оценка эфирного времени кадра ESP-NOW на 1 Мбит/с: преамбула и заголовки 802.11 (~50 байт),
+// заголовок и CRC PJON (~15 байт) плюс полезная нагрузка, по 8 мкс на байт.
+const uint32_t FRAME_OVERHEAD_BYTES = 65;
+const uint32_t AIRTIME_US_PER_BYTE = 8;
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+// Несколько сообщений могут разделять один handle (один кадр), поэтому считаем сообщения по handle
+struct PendingFrame
+{
+    ROKOR_Mesh_TxHandle handle;
+    uint16_t messages;
+    uint16_t bytes;
+};
+PendingFrame pendingFrames[ROKOR_MESH_TX_QUEUE_SIZE * 2];
+
+uint32_t ackedMessages = 0;
+uint32_t ackedFrames = 0;
+uint32_t ackedBytes = 0;
+uint32_t phaseStart = 0;
+bool batchingPhase = true;
+
+uint32_t gatewayReceived = 0;
+uint32_t gatewayLastReport = 0;
+
+void trackEnqueued(ROKOR_Mesh_TxHandle handle, uint16_t length)
+{
+    PendingFrame *freeEntry = nullptr;
+    for (auto &entry : pendingFrames)
+    {
+        if (entry.handle == handle)
+        {
+            entry.messages++;
+            entry.bytes += length;
+            return;
+        }
+        if (!freeEntry && entry.handle == ROKOR_MESH_INVALID_TX_HANDLE)
+        {
+            freeEntry = &entry;
+        }
+    }
+    if (freeEntry)
+    {
+        freeEntry->handle = handle;
+        freeEntry->messages = 1;
+        freeEntry->bytes = length;
+    }
+}
+
+void txComplete(ROKOR_Mesh_TxHandle handle, uint8_t destinationId, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    for (auto &entry : pendingFrames)
+    {
+        if (entry.handle != handle)
+            continue;
+        if (status == TX_STATUS_ACK)
+        {
+            ackedMessages += entry.messages;
+            ackedBytes += entry.bytes;
+            ackedFrames++;
+        }
+        entry.handle = ROKOR_MESH_INVALID_TX_HANDLE;
+        return;
+    }
+}
+
+void dataReceiver(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+    gatewayReceived++;
+}
+
+void startPhase(bool batching)
+{
+    batchingPhase = batching;
+    myMesh.setBatching(batching, BATCH_WINDOW_MS);
+    ackedMessages = 0;
+    ackedFrames = 0;
+    ackedBytes = 0;
+    phaseStart = millis();
+}
+
+void reportPhase()
+{
+    float seconds = (millis() - phaseStart) / 1000.0f;
+    Serial.printf("[УЗЕЛ] Объединение %s: %.1f сообщ./с", batchingPhase ? "ВКЛ " : "ВЫКЛ", ackedMessages / seconds);
+    if (ackedMessages > 0)
+    {
+        uint32_t airtimeUs = (ackedFrames * FRAME_OVERHEAD_BYTES + ackedBytes) * AIRTIME_US_PER_BYTE;
+        Serial.printf(", кадров на сообщение: %.2f, эфир на сообщение: ~%lu мкс",
+                      (float)ackedFrames / ackedMessages, (unsigned long)(airtimeUs / ackedMessages));
+    }
+    Serial.println();
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Сравнение отправки с объединением кадров и без ---");
+
+    myMesh.setReceiveCallback(dataReceiver);
+    myMesh.setTxCompleteCallback(txComplete);
+
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+    startPhase(true);
+}
+
+void loop()
+{
+    myMesh.update();
+
+    if (myMesh.getRole() == ROLE_GATEWAY)
+    {
+        if (millis() - gatewayLastReport >= 1000)
+        {
+            Serial.printf("[ШЛЮЗ] Принято сообщений за секунду: %lu\n", (unsigned long)gatewayReceived);
+            gatewayReceived = 0;
+            gatewayLastReport = millis();
+        }
+        return;
+    }
+
+    if (myMesh.getRole() != ROLE_NODE || !myMesh.isGatewayConnected())
+    {
+        phaseStart = millis();
+        return;
+    }
+
+    // Заполняем очередь, пока она принимает сообщения
+    uint8_t reading[READING_SIZE];
+    for (uint8_t i = 0; i < READING_SIZE; i++)
+    {
+        reading[i] = (uint8_t)(millis() + i);
+    }
+    // Шлюз в этом примере определяется автоматически и получает ID по умолчанию
+    ROKOR_Mesh_TxHandle handle = myMesh.enqueueMessage(ROKOR_MESH_DEFAULT_GATEWAY_ID, reading, READING_SIZE);
+    if (handle != ROKOR_MESH_INVALID_TX_HANDLE)
+    {
+        trackEnqueued(handle, READING_SIZE);
+    }
+
+    if (millis() - phaseStart >= TEST_PHASE_MS)
+    {
+        reportPhase();
+        startPhase(!batchingPhase);
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ * ROKOR_Mesh_FLP - Пример FastRejoin_Benchmark
+ *
+ * Этот скетч измеряет время от старта Узла до первого доставленного шлюзу сообщения.
+ * Загрузите его на два устройства с одинаковым именем сети: одно станет Шлюзом, другое - Узлом.
+ *
+ * Узел при старте с сохраненной в NVS конфигурацией сразу пингует известный шлюз
+ * (повторы через 20, 40, 80... мс) и считается подключенным по первому ответу.
+ * Как только связь есть, узел ставит в очередь сообщение и по TX_STATUS_ACK выводит:
+ *   - время от старта (millis()) до доставки;
+ *   - время от вызова begin() до доставки.
+ * Через RESTART_DELAY_MS узел перезагружается (ESP.restart()) и повторяет измерение;
+ * среднее и максимум по перезагрузкам хранятся в RTC-памяти. Первый запуск (без NVS)
+ * проходит поиск шлюза и выдачу ID и в статистику не входит.
+ * Шлюз выводит принятые сообщения. Для полного "холодного" старта нажимайте RESET на узле.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "RejoinBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint32_t RESTART_DELAY_MS = 3000;
+const uint32_t STATS_MAGIC = 0x524A4F4E;
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+// Переживают ESP.restart()
+RTC_NOINIT_ATTR uint32_t statsMagic;
+RTC_NOINIT_ATTR uint32_t statsCount;
+RTC_NOINIT_ATTR uint32_t statsSumMs;
+RTC_NOINIT_ATTR uint32_t statsMaxMs;
+
+uint32_t beginMs = 0;
+bool wasConfigured = false;
+ROKOR_Mesh_TxHandle probeHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+bool delivered = false;
+uint32_t deliveredAt = 0;
+
+void txComplete(ROKOR_Mesh_TxHandle handle, uint8_t destinationId, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    if (handle != probeHandle)
+        return;
+    probeHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+    if (status != TX_STATUS_ACK)
+    {
+        Serial.printf("[УЗЕЛ] Ошибка доставки (статус %d), повтор\n", status);
+        return;
+    }
+    deliveredAt = millis();
+    delivered = true;
+    uint32_t fromBoot = deliveredAt;
+    Serial.printf("[УЗЕЛ] Первое сообщение доставлено: %lu мс от старта, %lu мс от begin()\n",
+                  (unsigned long)fromBoot, (unsigned long)(deliveredAt - beginMs));
+
+    if (wasConfigured)
+    {
+        statsCount++;
+        statsSumMs += fromBoot;
+        if (fromBoot > statsMaxMs)
+        {
+            statsMaxMs = fromBoot;
+        }
+        Serial.printf("[УЗЕЛ] По %lu перезагрузкам: среднее %lu мс, максимум %lu мс\n", (unsigned long)statsCount,
+                      (unsigned long)(statsSumMs / statsCount), (unsigned long)statsMaxMs);
+    }
+}
+
+void dataReceiver(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+    Serial.printf("[ШЛЮЗ] Принято сообщение от ID %d\n", senderId);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Время до первого сообщения после старта ---");
+
+    if (statsMagic != STATS_MAGIC)
+    {
+        statsMagic = STATS_MAGIC;
+        statsCount = 0;
+        statsSumMs = 0;
+        statsMaxMs = 0;
+    }
+
+    myMesh.setReceiveCallback(dataReceiver);
+    myMesh.setTxCompleteCallback(txComplete);
+
+    beginMs = millis();
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+}
+
+void loop()
+{
+    myMesh.update();
+
+    if (myMesh.getRole() == ROLE_GATEWAY)
+        return;
+
+    if (delivered)
+    {
+        if (millis() - deliveredAt >= RESTART_DELAY_MS)
+        {
+            ESP.restart();
+        }
+        return;
+    }
+
+    if (myMesh.getRole() != ROLE_NODE)
+    {
+        // Узел без сохраненной конфигурации сначала ищет шлюз
+        return;
+    }
+    if (!myMesh.isGatewayConnected())
+    {
+        // Роль узла известна до подключения только при старте с конфигурацией из NVS
+        wasConfigured = true;
+        return;
+    }
+    if (probeHandle == ROKOR_MESH_INVALID_TX_HANDLE)
+    {
+        uint32_t now = millis();
+        probeHandle = myMesh.enqueueMessage(myMesh.getGatewayId(), (const uint8_t *)&now, sizeof(now));
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * ROKOR_Mesh_FLP - Пример Fragmentation_Benchmark
+ *
+ * Этот скетч измеряет скорость передачи сообщений длиннее ROKOR_MESH_MAX_PAYLOAD_SIZE,
+ * которые библиотека автоматически разбивает на фрагменты. Загрузите его на два
+ * устройства с одинаковым именем сети: одно станет Шлюзом, другое - Узлом.
+ *
+ * Узел по очереди отправляет сообщения размером 4, 8 и 16 КБ в двух режимах:
+ *   - окно из 8 фрагментов (подтверждение одним FRAGMENT_STATUS на окно);
+ *   - окно из 1 фрагмента, что соответствует поштучной отправке с ожиданием подтверждения.
+ * Для каждого сообщения выводится время доставки и скорость в КБ/с.
+ *
+ * Размер сообщения ограничен ROKOR_MESH_MAX_MESSAGE_SIZE (по умолчанию 4096 байт).
+ * Для сообщений 8 и 16 КБ соберите проект с флагом -DROKOR_MESH_MAX_MESSAGE_SIZE=16384
+ * (на обоих устройствах), иначе большие размеры будут пропущены.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "FragBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint16_t TEST_SIZES[] = {4096, 8192, 16384};
+const uint8_t TEST_WINDOWS[] = {8, 1};
+const uint32_t PAUSE_BETWEEN_TESTS_MS = 1000;
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+static uint8_t bulkMessage[ROKOR_MESH_MAX_MESSAGE_SIZE];
+
+uint8_t sizeIndex = 0;
+uint8_t windowIndex = 0;
+ROKOR_Mesh_TxHandle currentHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+uint32_t sendStart = 0;
+uint32_t nextTestTime = 0;
+
+void txComplete(ROKOR_Mesh_TxHandle handle, uint8_t destinationId, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    if (handle != currentHandle)
+        return;
+    uint32_t elapsed = millis() - sendStart;
+    uint16_t size = TEST_SIZES[sizeIndex];
+    if (status == TX_STATUS_ACK)
+    {
+        Serial.printf("[УЗЕЛ] %5u байт, окно %2u: %lu мс, %.1f КБ/с\n", size, TEST_WINDOWS[windowIndex],
+                      (unsigned long)elapsed, elapsed > 0 ? (size / 1024.0f) / (elapsed / 1000.0f) : 0.0f);
+    }
+    else
+    {
+        Serial.printf("[УЗЕЛ] %5u байт, окно %2u: ошибка доставки (статус %d)\n", size, TEST_WINDOWS[windowIndex], status);
+    }
+    currentHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+    nextTestTime = millis() + PAUSE_BETWEEN_TESTS_MS;
+
+    // Следующая комбинация размер/окно
+    if (++windowIndex >= sizeof(TEST_WINDOWS))
+    {
+        windowIndex = 0;
+        sizeIndex = (sizeIndex + 1) % (sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]));
+    }
+}
+
+void dataReceiver(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+    Serial.printf("[ШЛЮЗ] Принято сообщение %u байт от ID %d\n", length, senderId);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Скорость передачи фрагментированных сообщений ---");
+
+    for (uint16_t i = 0; i < sizeof(bulkMessage); i++)
+    {
+        bulkMessage[i] = (uint8_t)i;
+    }
+
+    myMesh.setReceiveCallback(dataReceiver);
+    myMesh.setTxCompleteCallback(txComplete);
+
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+}
+
+void loop()
+{
+    myMesh.update();
+
+    if (myMesh.getRole() != ROLE_NODE || !myMesh.isGatewayConnected())
+        return;
+    if (currentHandle != ROKOR_MESH_INVALID_TX_HANDLE || (int32_t)(millis() - nextTestTime) < 0)
+        return;
+
+    uint16_t size = TEST_SIZES[sizeIndex];
+    if (size > ROKOR_MESH_MAX_MESSAGE_SIZE)
+    {
+        sizeIndex = (sizeIndex + 1) % (sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]));
+        return;
+    }
+
+    myMesh.setFragmentWindow(TEST_WINDOWS[windowIndex]);
+    sendStart = millis();
+    // Шлюз в этом примере определяется автоматически и получает ID по умолчанию
+    currentHandle = myMesh.enqueueMessage(ROKOR_MESH_DEFAULT_GATEWAY_ID, bulkMessage, size);
+    if (currentHandle == ROKOR_MESH_INVALID_TX_HANDLE)
+    {
+        nextTestTime = millis() + PAUSE_BETWEEN_TESTS_MS;
+    }
+}
@@ -0,0 +1,146 @@
+/**
+ * ROKOR_Mesh_FLP - Пример NodeJoin_Benchmark
+ *
+ * Этот скетч измеряет время выдачи PJON ID новому узлу по мере заполнения таблицы шлюза,
+ * как при "шторме" подключений после перезагрузки шлюза. Достаточно одного устройства:
+ * оно принудительно становится Шлюзом и выдает ID вымышленным MAC (assignNodeId),
+ * тем же путем, что и при NODE_ID_REQUEST.
+ *
+ * На отметках 50, 100, 150, 200 и 250 узлов выводится среднее время одного подключения
+ * (по JOINS_PER_SAMPLE подключениям до отметки) и, для сравнения, время прежнего выбора ID
+ * перебором кандидатов с проверкой каждого по всей таблице (повторен в скетче).
+ * Пир ESP-NOW при выдаче ID не регистрируется (это происходит при первой отправке узлу),
+ * поэтому измеряется только работа с таблицей узлов.
+ *
+ * Соберите проект с флагом -DROKOR_MESH_MAX_NODES=253, иначе таблица вмещает 30 узлов.
+ * Диапазон RESERVED_FIRST..RESERVED_LAST резервируется под узлы с forceRoleNode()
+ * и автоматически не выдается.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "NodeJoinBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint16_t CHECKPOINTS[] = {50, 100, 150, 200, 250};
+const uint8_t JOINS_PER_SAMPLE = 10;
+const uint8_t RESERVED_FIRST = 253;
+const uint8_t RESERVED_LAST = 254;
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+uint8_t assignedIds[253];
+uint16_t joinedCount = 0;
+bool benchmarkDone = false;
+volatile uint8_t sink;
+
+void makeMac(uint16_t index, uint8_t *mac)
+{
+    mac[0] = 0x24;
+    mac[1] = 0x6F;
+    mac[2] = 0x28;
+    mac[3] = 0x10;
+    mac[4] = (uint8_t)(index >> 8);
+    mac[5] = (uint8_t)index;
+}
+
+// Прежний алгоритм: кандидаты с 2, каждый проверяется перебором всех узлов
+uint8_t legacyAllocate(uint16_t count)
+{
+    uint8_t candidate = 2;
+    for (int attempt = 0; attempt < 254; attempt++)
+    {
+        bool taken = false;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            if (assignedIds[i] == candidate)
+            {
+                taken = true;
+                break;
+            }
+        }
+        if (!taken)
+            return candidate;
+        candidate++;
+    }
+    return 255;
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Выдача ID при подключении узлов ---");
+
+    myMesh.forceRoleGateway(ROKOR_MESH_DEFAULT_GATEWAY_ID);
+    myMesh.reserveNodeIds(RESERVED_FIRST, RESERVED_LAST);
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+}
+
+void loop()
+{
+    myMesh.update();
+
+    if (benchmarkDone || myMesh.getRole() != ROLE_GATEWAY)
+        return;
+    benchmarkDone = true;
+
+    for (uint8_t c = 0; c < sizeof(CHECKPOINTS) / sizeof(CHECKPOINTS[0]); c++)
+    {
+        uint16_t target = CHECKPOINTS[c];
+        if (target > ROKOR_MESH_MAX_NODES)
+        {
+            Serial.printf("[ШЛЮЗ] %3u узлов: пропущено (ROKOR_MESH_MAX_NODES = %d)\n", target, ROKOR_MESH_MAX_NODES);
+            continue;
+        }
+
+        uint32_t sampleUs = 0;
+        uint8_t samples = 0;
+        while (joinedCount < target)
+        {
+            uint8_t mac[6];
+            makeMac(joinedCount, mac);
+            uint32_t start = micros();
+            uint8_t id = myMesh.assignNodeId(mac);
+            uint32_t elapsed = micros() - start;
+            if (id == PJON_NOT_ASSIGNED)
+            {
+                Serial.printf("[ШЛЮЗ] Нет свободного ID для узла %u\n", joinedCount);
+                return;
+            }
+            if (id >= RESERVED_FIRST && id <= RESERVED_LAST)
+            {
+                Serial.printf("[ШЛЮЗ] Ошибка: выдан зарезервированный ID %u\n", id);
+            }
+            if (target - joinedCount <= JOINS_PER_SAMPLE)
+            {
+                sampleUs += elapsed;
+                samples++;
+            }
+            assignedIds[joinedCount++] = id;
+        }
+
+        uint32_t start = micros();
+        for (uint8_t i = 0; i < JOINS_PER_SAMPLE; i++)
+        {
+            sink = legacyAllocate(joinedCount);
+        }
+        uint32_t legacyUs = (micros() - start) / JOINS_PER_SAMPLE;
+
+        Serial.printf("[ШЛЮЗ] %3u узлов: подключение %lu мкс, прежний выбор ID %lu мкс\n", target,
+                      (unsigned long)(samples ? sampleUs / samples : 0), (unsigned long)legacyUs);
+    }
+    Serial.printf("[ШЛЮЗ] Узлов в таблице: %u\n", myMesh.getNodeCount());
+}
@@ -0,0 +1,137 @@
+/**
+ * ROKOR_Mesh_FLP - Пример NodeTable_Benchmark
+ *
+ * Этот скетч измеряет время поиска узла в таблице шлюза по PJON ID и по MAC
+ * в зависимости от числа узлов. Достаточно одного устройства: оно принудительно
+ * становится Шлюзом и регистрирует (registerNode) узлы с вымышленными MAC.
+ *
+ * Для каждого размера таблицы выводится среднее время (в тактах процессора):
+ *   - поиска по ID (getLinkStats: индекс ID -> слот);
+ *   - поиска по MAC (getNodeIdByMac: хеш-таблица);
+ *   - для сравнения - линейного перебора того же числа MAC в скетче.
+ * Время поиска библиотеки не должно расти с числом узлов, перебора - растет линейно.
+ *
+ * По умолчанию таблица вмещает ROKOR_MESH_MAX_NODES = 30 узлов. Для полного теста
+ * соберите проект с флагом -DROKOR_MESH_MAX_NODES=253, иначе большие размеры будут пропущены.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "NodeTableBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint16_t TEST_SIZES[] = {8, 32, 64, 128, 253};
+const uint32_t LOOKUPS_PER_TEST = 20000;
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+uint8_t nodeMacs[253][6];
+uint8_t nodeIds[253];
+uint16_t registeredCount = 0;
+bool benchmarkDone = false;
+
+void makeMac(uint16_t index, uint8_t *mac)
+{
+    // Один производитель (OUI), отличаются младшие байты, как у реальных плат
+    mac[0] = 0x24;
+    mac[1] = 0x6F;
+    mac[2] = 0x28;
+    mac[3] = (uint8_t)(index * 37);
+    mac[4] = (uint8_t)(index >> 3);
+    mac[5] = (uint8_t)index;
+}
+
+volatile uint8_t sink; // Не дает компилятору выбросить цикл поиска
+
+int linearFind(const uint8_t *mac, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (memcmp(nodeMacs[i], mac, 6) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void runTest(uint16_t size)
+{
+    while (registeredCount < size)
+    {
+        uint8_t id = (uint8_t)(registeredCount + 2); // ID 1 занят шлюзом
+        makeMac(registeredCount, nodeMacs[registeredCount]);
+        nodeIds[registeredCount] = id;
+        if (!myMesh.registerNode(id, nodeMacs[registeredCount]))
+        {
+            Serial.printf("[ШЛЮЗ] Не удалось зарегистрировать узел %u\n", registeredCount);
+            return;
+        }
+        registeredCount++;
+    }
+
+    ROKOR_Mesh_LinkStats stats;
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < LOOKUPS_PER_TEST; i++)
+    {
+        sink = myMesh.getLinkStats(nodeIds[(i * 7) % size], stats);
+    }
+    uint32_t idCycles = ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < LOOKUPS_PER_TEST; i++)
+    {
+        sink = myMesh.getNodeIdByMac(nodeMacs[(i * 7) % size]);
+    }
+    uint32_t macCycles = ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < LOOKUPS_PER_TEST; i++)
+    {
+        sink = (uint8_t)linearFind(nodeMacs[(i * 7) % size], size);
+    }
+    uint32_t linearCycles = ESP.getCycleCount() - start;
+
+    Serial.printf("[ШЛЮЗ] %3u узлов: по ID %lu тактов, по MAC %lu тактов, перебор MAC %lu тактов\n", size,
+                  (unsigned long)(idCycles / LOOKUPS_PER_TEST), (unsigned long)(macCycles / LOOKUPS_PER_TEST),
+                  (unsigned long)(linearCycles / LOOKUPS_PER_TEST));
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Поиск в таблице узлов шлюза ---");
+
+    myMesh.forceRoleGateway(ROKOR_MESH_DEFAULT_GATEWAY_ID);
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+}
+
+void loop()
+{
+    myMesh.update();
+
+    if (benchmarkDone || myMesh.getRole() != ROLE_GATEWAY)
+        return;
+
+    for (uint8_t t = 0; t < sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]); t++)
+    {
+        if (TEST_SIZES[t] > ROKOR_MESH_MAX_NODES)
+        {
+            Serial.printf("[ШЛЮЗ] %3u узлов: пропущено (ROKOR_MESH_MAX_NODES = %d)\n", TEST_SIZES[t], ROKOR_MESH_MAX_NODES);
+            continue;
+        }
+        runTest(TEST_SIZES[t]);
+    }
+    benchmarkDone = true;
+}
@@ -0,0 +1,147 @@
+/**
+ * ROKOR_Mesh_FLP - Пример NonBlocking_Update_Benchmark
+ *
+ * Этот скетч сравнивает обычный update(), который ждет прием до 10 мс, с неблокирующим
+ * режимом (setNonBlockingUpdate). Загрузите его на два устройства с одинаковым именем сети:
+ * одно станет Шлюзом, другое - Узлом.
+ *
+ * Узел по очереди (по TEST_PHASE_MS) работает в трех режимах:
+ *   - BLOCK: update() с ожиданием приема (по умолчанию);
+ *   - SPIN:  неблокирующий update() в каждом проходе loop();
+ *   - WAIT:  неблокирующий update() после waitForActivity() (процессор свободен между кадрами).
+ * Каждые PING_INTERVAL_MS узел отправляет шлюзу метку времени, шлюз возвращает ее обратно.
+ * Шлюз всегда работает в режиме SPIN, чтобы его задержка не влияла на сравнение.
+ * По итогам фазы выводятся:
+ *   - число проходов loop() в секунду;
+ *   - средняя и максимальная задержка "узел -> шлюз -> узел".
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+const char *MY_NETWORK_NAME = "UpdateBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint32_t TEST_PHASE_MS = 10000;
+const uint32_t PING_INTERVAL_MS = 100;
+const uint32_t WAIT_TIMEOUT_MS = 5; // Не больше шага таймеров библиотеки (повторы, опрос шлюза)
+
+enum TestMode
+{
+    MODE_BLOCK,
+    MODE_SPIN,
+    MODE_WAIT
+};
+const char *MODE_NAMES[] = {"BLOCK", "SPIN ", "WAIT "};
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+TestMode mode = MODE_BLOCK;
+uint32_t phaseStart = 0;
+uint32_t loopCount = 0;
+uint32_t lastPingTime = 0;
+uint32_t rttCount = 0;
+uint64_t rttSumUs = 0;
+uint32_t rttMaxUs = 0;
+
+void dataReceiver(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+    if (myMesh.getRole() == ROLE_GATEWAY)
+    {
+        // Эхо: возвращаем метку времени отправителю
+        myMesh.sendMessage(senderId, payload, length);
+        return;
+    }
+    if (length != sizeof(uint32_t))
+        return;
+    uint32_t sentUs;
+    memcpy(&sentUs, payload, sizeof(sentUs));
+    uint32_t rttUs = micros() - sentUs;
+    rttCount++;
+    rttSumUs += rttUs;
+    if (rttUs > rttMaxUs)
+    {
+        rttMaxUs = rttUs;
+    }
+}
+
+void startPhase(TestMode newMode)
+{
+    mode = newMode;
+    myMesh.setNonBlockingUpdate(mode != MODE_BLOCK);
+    loopCount = 0;
+    rttCount = 0;
+    rttSumUs = 0;
+    rttMaxUs = 0;
+    phaseStart = millis();
+}
+
+void reportPhase()
+{
+    float seconds = (millis() - phaseStart) / 1000.0f;
+    Serial.printf("[УЗЕЛ] %s: %.0f проходов loop()/с", MODE_NAMES[mode], loopCount / seconds);
+    if (rttCount > 0)
+    {
+        Serial.printf(", задержка эха: средняя %lu мкс, максимальная %lu мкс (%lu ответов)",
+                      (unsigned long)(rttSumUs / rttCount), (unsigned long)rttMaxUs, (unsigned long)rttCount);
+    }
+    Serial.println();
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Блокирующий и неблокирующий update() ---");
+
+    myMesh.setReceiveCallback(dataReceiver);
+
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+    startPhase(MODE_BLOCK);
+}
+
+void loop()
+{
+    if (mode == MODE_WAIT)
+    {
+        myMesh.waitForActivity(WAIT_TIMEOUT_MS);
+    }
+    myMesh.update();
+    loopCount++;
+
+    if (myMesh.getRole() == ROLE_GATEWAY)
+    {
+        myMesh.setNonBlockingUpdate(true);
+        return;
+    }
+    if (myMesh.getRole() != ROLE_NODE || !myMesh.isGatewayConnected())
+    {
+        phaseStart = millis();
+        loopCount = 0;
+        return;
+    }
+
+    if (millis() - lastPingTime >= PING_INTERVAL_MS)
+    {
+        lastPingTime = millis();
+        uint32_t nowUs = micros();
+        myMesh.sendMessage((const uint8_t *)&nowUs, sizeof(nowUs));
+    }
+
+    if (millis() - phaseStart >= TEST_PHASE_MS)
+    {
+        reportPhase();
+        startPhase((TestMode)((mode + 1) % 3));
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * ROKOR_Mesh_FLP - Пример StandbyFailover_Benchmark
+ *
+ * Этот скетч измеряет перерыв в доставке сообщений при отказе шлюза, если в сети есть резервный шлюз.
+ * Загрузите его на три устройства с одинаковым именем сети, задав DEVICE_KIND:
+ *   - KIND_GATEWAY: основной шлюз (forceRoleGateway);
+ *   - KIND_STANDBY: резервный шлюз (setStandbyGateway), держит копию таблицы узлов;
+ *   - KIND_NODE:    узел, каждые SEND_INTERVAL_MS отправляет шлюзу сообщение.
+ * Сначала включите шлюз, затем резерв и узел. Когда узел начнет выводить доставку, обесточьте шлюз:
+ * резерв займет его место с тем же PJON ID, а узел выведет длительность перерыва в доставке
+ * (от последнего подтвержденного сообщения до первого подтвержденного новым шлюзом) и сохранит свой ID.
+ */
+
+#include <ROKOR_Mesh_FLP.h>
+
+enum DeviceKind
+{
+    KIND_GATEWAY,
+    KIND_STANDBY,
+    KIND_NODE
+};
+const DeviceKind DEVICE_KIND = KIND_NODE;
+
+const char *MY_NETWORK_NAME = "StandbyBenchNet";
+const uint8_t WIFI_CHANNEL = 1;
+
+const uint32_t SEND_INTERVAL_MS = 50;
+const uint32_t GAP_REPORT_THRESHOLD_MS = 200; // Более долгий перерыв между подтверждениями выводится
+
+ROKOR_Mesh myMesh;
+ROKOR_Mesh *global_ROKOR_Mesh_instance = &myMesh;
+
+ROKOR_Mesh_TxHandle currentHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+uint32_t lastSendTime = 0;
+uint32_t lastAckTime = 0;
+uint32_t ackCount = 0;
+ROKOR_Mesh_Role lastRole = ROLE_UNINITIALIZED;
+
+void txComplete(ROKOR_Mesh_TxHandle handle, uint8_t destinationId, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    if (handle != currentHandle)
+        return;
+    currentHandle = ROKOR_MESH_INVALID_TX_HANDLE;
+    if (status != TX_STATUS_ACK)
+        return;
+
+    uint32_t now = millis();
+    if (lastAckTime != 0 && now - lastAckTime >= GAP_REPORT_THRESHOLD_MS)
+    {
+        Serial.printf("[УЗЕЛ] Перерыв в доставке: %lu мс, мой ID %d\n", (unsigned long)(now - lastAckTime), myMesh.getPjonId());
+    }
+    lastAckTime = now;
+    if (++ackCount % 100 == 0)
+    {
+        Serial.printf("[УЗЕЛ] Доставлено %lu сообщений\n", (unsigned long)ackCount);
+    }
+}
+
+void dataReceiver(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+        delay(10);
+    }
+    delay(1000);
+    Serial.println("\n--- ROKOR_Mesh_FLP: Переключение на резервный шлюз ---");
+
+    if (DEVICE_KIND == KIND_GATEWAY)
+    {
+        myMesh.forceRoleGateway(ROKOR_MESH_DEFAULT_GATEWAY_ID);
+    }
+    else if (DEVICE_KIND == KIND_STANDBY)
+    {
+        myMesh.setStandbyGateway(true);
+    }
+    myMesh.setReceiveCallback(dataReceiver);
+    myMesh.setTxCompleteCallback(txComplete);
+
+    if (!myMesh.begin(MY_NETWORK_NAME, WIFI_CHANNEL))
+    {
+        Serial.println("Ошибка инициализации ROKOR_Mesh!");
+        while (true)
+        {
+            delay(1000);
+        }
+    }
+}
+
+void loop()
+{
+    myMesh.update();
+
+    ROKOR_Mesh_Role role = myMesh.getRole();
+    if (role != lastRole)
+    {
+        lastRole = role;
+        if (role == ROLE_STANDBY_GATEWAY)
+        {
+            Serial.printf("[РЕЗЕРВ] Резервный шлюз для шлюза ID %d\n", myMesh.getGatewayId());
+        }
+        else if (role == ROLE_GATEWAY)
+        {
+            Serial.printf("[ШЛЮЗ] Работаю шлюзом, ID %d, узлов %d\n", myMesh.getPjonId(), myMesh.getNodeCount());
+        }
+    }
+
+    if (role != ROLE_NODE || !myMesh.isGatewayConnected())
+        return;
+    if (currentHandle != ROKOR_MESH_INVALID_TX_HANDLE || millis() - lastSendTime < SEND_INTERVAL_MS)
+        return;
+    lastSendTime = millis();
+    currentHandle = myMesh.enqueueMessage(myMesh.getGatewayId(), (const uint8_t *)&lastSendTime, sizeof(lastSendTime));
+}
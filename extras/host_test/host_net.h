@@ -0,0 +1,66 @@
+// Тестовая среда на хосте: модельное время, эфир ESP-NOW и несколько экземпляров ROKOR_Mesh
+#pragma once
+#include "ROKOR_Mesh_FLP.h"
+#include <stdio.h>
+#include <vector>
+
+// Кадр в эфире: MAC отправителя и получателя, кадр PJON-заглушки [ID получателя][ID отправителя][данные]
+struct HostFrame
+{
+    uint8_t src_mac[6];
+    uint8_t dst_mac[6];
+    uint8_t data[250];
+    uint16_t length;
+    bool ack_requested; // Отправитель ждал бы ACK PJON внутри send_packet()/update()
+};
+
+extern uint64_t host_time_us;
+extern std::vector<HostFrame> host_air; // Все переданные кадры по порядку
+
+void host_reset(uint32_t seed);
+void host_advance_ms(uint32_t ms);
+// Текущее устройство: его MAC возвращает esp_wifi_get_mac(), под ним хранятся ключи NVS
+void host_select(ROKOR_Mesh *mesh, const uint8_t mac[6]);
+// Кадр от src_mac попадает в callback приема ESP-NOW выбранного устройства
+void host_deliver(const uint8_t *src_mac, const uint8_t *data, uint16_t length);
+
+// Фильтр потерь: true - кадр пропадает
+typedef bool (*HostDropFilter)(const HostFrame &frame);
+
+// Сеть из нескольких устройств в одном эфире. Экземпляры создает и удаляет вызывающий.
+class HostNet
+{
+public:
+    void add(ROKOR_Mesh *mesh, const uint8_t mac[6]);
+    void select(size_t index);
+    // update() одного устройства; переданные им кадры сразу доставляются остальным
+    void update(size_t index, HostDropFilter drop = nullptr);
+    // Вызывает update() каждого устройства, доставляет переданные кадры и сдвигает время на step_ms
+    void step(uint32_t step_ms, HostDropFilter drop = nullptr);
+    void run(uint32_t duration_ms, uint32_t step_ms = 5, HostDropFilter drop = nullptr);
+    // Приостановленное устройство (зависло или вне связи) не обновляется и ничего не принимает
+    void setPaused(size_t index, bool paused) { _devices[index].paused = paused; }
+    ROKOR_Mesh &mesh(size_t index) { return *_devices[index].mesh; }
+    size_t size() const { return _devices.size(); }
+
+private:
+    struct Device
+    {
+        ROKOR_Mesh *mesh;
+        uint8_t mac[6];
+        bool paused;
+    };
+    std::vector<Device> _devices;
+};
+
+// Проверка теста: при ошибке печатает условие и строку, счетчик ошибок растет
+extern int host_failures;
+#define HOST_CHECK(cond)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);            \
+            host_failures++;                                                    \
+        }                                                                       \
+    } while (0)
@@ -0,0 +1,330 @@
+// Реализация заглушек ESP-IDF/Arduino/FreeRTOS и тестовой среды host_net.h
+#include "host_net.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_random.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "mbedtls/sha1.h"
+#include <stdlib.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+bool host_serial_verbose = getenv("HOST_TEST_VERBOSE") != nullptr;
+HostSerial Serial;
+HostWiFi WiFi;
+int host_failures = 0;
+
+uint64_t host_time_us = 0;
+std::vector<HostFrame> host_air;
+
+static uint8_t host_current_mac[6];
+static uint32_t host_random_state = 1;
+static esp_now_recv_cb_t host_recv_cb = nullptr;
+static std::set<std::string> host_peers;
+static std::map<std::string, std::vector<uint8_t>> host_nvs;
+static std::vector<std::string> host_nvs_handles;
+
+static std::string macKey(const uint8_t *mac) { return std::string((const char *)mac, 6); }
+
+void host_reset(uint32_t seed)
+{
+    host_time_us = 1000000; // millis() != 0: часть таймеров библиотеки считает 0 "не запущен"
+    host_air.clear();
+    host_peers.clear();
+    host_nvs.clear();
+    host_nvs_handles.clear();
+    host_random_state = seed ? seed : 1;
+}
+
+void host_advance_ms(uint32_t ms) { host_time_us += (uint64_t)ms * 1000; }
+
+void host_select(ROKOR_Mesh *mesh, const uint8_t mac[6])
+{
+    global_ROKOR_Mesh_instance = mesh;
+    memcpy(host_current_mac, mac, 6);
+}
+
+void host_deliver(const uint8_t *src_mac, const uint8_t *data, uint16_t length)
+{
+    if (!host_recv_cb)
+        return;
+    esp_now_recv_info_t info;
+    uint8_t src[6];
+    memcpy(src, src_mac, 6);
+    info.src_addr = src;
+    info.des_addr = host_current_mac;
+    info.rx_ctrl = nullptr;
+    host_recv_cb(&info, data, length);
+}
+
+void host_radio_send(const uint8_t *dst_mac, const uint8_t *frame, uint16_t length, bool ack_requested)
+{
+    HostFrame air_frame;
+    memcpy(air_frame.src_mac, host_current_mac, 6);
+    memcpy(air_frame.dst_mac, dst_mac, 6);
+    memcpy(air_frame.data, frame, length);
+    air_frame.length = length;
+    air_frame.ack_requested = ack_requested;
+    host_air.push_back(air_frame);
+}
+
+void HostNet::add(ROKOR_Mesh *mesh, const uint8_t mac[6])
+{
+    Device device;
+    device.mesh = mesh;
+    memcpy(device.mac, mac, 6);
+    device.paused = false;
+    _devices.push_back(device);
+}
+
+void HostNet::select(size_t index) { host_select(_devices[index].mesh, _devices[index].mac); }
+
+void HostNet::update(size_t index, HostDropFilter drop)
+{
+    static const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    size_t first_frame = host_air.size();
+    select(index);
+    _devices[index].mesh->update();
+    for (size_t f = first_frame; f < host_air.size(); ++f)
+    {
+        HostFrame frame = host_air[f];
+        if (drop && drop(frame))
+            continue;
+        bool broadcast = memcmp(frame.dst_mac, broadcast_mac, 6) == 0;
+        for (size_t j = 0; j < _devices.size(); ++j)
+        {
+            if (j == index || _devices[j].paused || (!broadcast && memcmp(frame.dst_mac, _devices[j].mac, 6) != 0))
+                continue;
+            select(j);
+            host_deliver(frame.src_mac, frame.data, frame.length);
+        }
+    }
+}
+
+void HostNet::step(uint32_t step_ms, HostDropFilter drop)
+{
+    for (size_t i = 0; i < _devices.size(); ++i)
+    {
+        if (!_devices[i].paused)
+            update(i, drop);
+    }
+    host_advance_ms(step_ms);
+}
+
+void HostNet::run(uint32_t duration_ms, uint32_t step_ms, HostDropFilter drop)
+{
+    for (uint32_t t = 0; t < duration_ms; t += step_ms)
+    {
+        step(step_ms, drop);
+    }
+}
+
+// --- Arduino ---
+uint32_t millis() { return (uint32_t)(host_time_us / 1000); }
+uint32_t micros() { return (uint32_t)host_time_us; }
+void delay(uint32_t ms) { host_advance_ms(ms); }
+
+// --- ESP-IDF ---
+const char *esp_err_to_name(esp_err_t) { return "host"; }
+
+uint32_t esp_random()
+{
+    // xorshift32: воспроизводимая последовательность при одном seed
+    host_random_state ^= host_random_state << 13;
+    host_random_state ^= host_random_state >> 17;
+    host_random_state ^= host_random_state << 5;
+    return host_random_state;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t, uint8_t *mac)
+{
+    memcpy(mac, host_current_mac, 6);
+    return ESP_OK;
+}
+esp_err_t esp_wifi_set_channel(uint8_t, wifi_second_chan_t) { return ESP_OK; }
+
+esp_err_t esp_now_init() { return ESP_OK; }
+esp_err_t esp_now_deinit() { return ESP_OK; }
+esp_err_t esp_now_set_pmk(const uint8_t *) { return ESP_OK; }
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t) { return ESP_OK; }
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+    host_recv_cb = cb;
+    return ESP_OK;
+}
+esp_err_t esp_now_unregister_send_cb() { return ESP_OK; }
+esp_err_t esp_now_unregister_recv_cb() { return ESP_OK; }
+
+// Таблица пиров у каждого устройства своя: ключ - MAC устройства и MAC пира
+bool esp_now_is_peer_exist(const uint8_t *mac) { return host_peers.count(macKey(host_current_mac) + macKey(mac)) != 0; }
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer)
+{
+    std::string prefix = macKey(host_current_mac);
+    size_t own = 0;
+    for (const std::string &key : host_peers)
+    {
+        own += key.compare(0, 6, prefix) == 0;
+    }
+    if (own >= ESP_NOW_MAX_TOTAL_PEER_NUM)
+        return ESP_ERR_ESPNOW_FULL;
+    host_peers.insert(prefix + macKey(peer->peer_addr));
+    return ESP_OK;
+}
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t *) { return ESP_OK; }
+esp_err_t esp_now_del_peer(const uint8_t *mac)
+{
+    host_peers.erase(macKey(host_current_mac) + macKey(mac));
+    return ESP_OK;
+}
+
+// --- NVS: ключи хранятся отдельно для каждого устройства ---
+esp_err_t nvs_flash_init() { return ESP_OK; }
+esp_err_t nvs_flash_erase()
+{
+    host_nvs.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t, nvs_handle_t *handle)
+{
+    host_nvs_handles.push_back(macKey(host_current_mac) + name + "/");
+    *handle = (nvs_handle_t)host_nvs_handles.size();
+    return ESP_OK;
+}
+void nvs_close(nvs_handle_t) {}
+esp_err_t nvs_commit(nvs_handle_t) { return ESP_OK; }
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    return host_nvs.erase(host_nvs_handles[handle - 1] + key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+static esp_err_t nvsSet(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)value;
+    host_nvs[host_nvs_handles[handle - 1] + key] = std::vector<uint8_t>(bytes, bytes + length);
+    return ESP_OK;
+}
+
+static esp_err_t nvsGet(nvs_handle_t handle, const char *key, void *out, size_t *length)
+{
+    auto it = host_nvs.find(host_nvs_handles[handle - 1] + key);
+    if (it == host_nvs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (!out)
+    {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (*length < it->second.size())
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *length) { return nvsGet(h, key, out, length); }
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *length) { return nvsGet(h, key, out, length); }
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out)
+{
+    size_t length = sizeof(*out);
+    return nvsGet(h, key, out, &length);
+}
+esp_err_t nvs_get_u16(nvs_handle_t h, const char *key, uint16_t *out)
+{
+    size_t length = sizeof(*out);
+    return nvsGet(h, key, out, &length);
+}
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    size_t length = sizeof(*out);
+    return nvsGet(h, key, out, &length);
+}
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value) { return nvsSet(h, key, value, strlen(value) + 1); }
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t length) { return nvsSet(h, key, value, length); }
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t value) { return nvsSet(h, key, &value, sizeof(value)); }
+esp_err_t nvs_set_u16(nvs_handle_t h, const char *key, uint16_t value) { return nvsSet(h, key, &value, sizeof(value)); }
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t value) { return nvsSet(h, key, &value, sizeof(value)); }
+
+// --- mbedtls: детерминированная замена SHA1 (тестам нужна только повторяемость) ---
+void mbedtls_sha1_init(mbedtls_sha1_context *ctx) { ctx->x = 0; }
+int mbedtls_sha1_starts_ret(mbedtls_sha1_context *ctx)
+{
+    ctx->x = 0x811C9DC5;
+    return 0;
+}
+int mbedtls_sha1_update_ret(mbedtls_sha1_context *ctx, const unsigned char *data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        ctx->x = (ctx->x ^ data[i]) * 16777619u;
+    }
+    return 0;
+}
+int mbedtls_sha1_finish_ret(mbedtls_sha1_context *ctx, unsigned char *out)
+{
+    uint32_t h = (uint32_t)ctx->x;
+    for (int i = 0; i < 20; ++i)
+    {
+        h = h * 1103515245u + 12345u;
+        out[i] = (unsigned char)(h >> 24);
+    }
+    return 0;
+}
+void mbedtls_sha1_free(mbedtls_sha1_context *) {}
+
+// --- FreeRTOS: задач нет, семафор - флаг, очередь - deque ---
+struct HostQueue
+{
+    UBaseType_t capacity;
+    UBaseType_t item_size;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) { return new HostQueue{length, item_size, {}}; }
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t)
+{
+    HostQueue *queue = (HostQueue *)handle;
+    if (queue->items.size() >= queue->capacity)
+        return pdFALSE;
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->item_size));
+    return pdTRUE;
+}
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t)
+{
+    HostQueue *queue = (HostQueue *)handle;
+    if (queue->items.empty())
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+void vQueueDelete(QueueHandle_t handle) { delete (HostQueue *)handle; }
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new bool(false); }
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new bool(true); }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t)
+{
+    bool *given = (bool *)handle;
+    bool was_given = *given;
+    *given = false;
+    return was_given ? pdTRUE : pdFALSE;
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle)
+{
+    *(bool *)handle = true;
+    return pdTRUE;
+}
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t handle, BaseType_t *) { return xSemaphoreGive(handle); }
+void vSemaphoreDelete(SemaphoreHandle_t handle) { delete (bool *)handle; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t) { return pdFALSE; }
+void vTaskDelete(TaskHandle_t) {}
+void vTaskDelay(TickType_t ticks) { host_advance_ms(ticks); }
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *) {}
+BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdTRUE; }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
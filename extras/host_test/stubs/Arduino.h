@@ -0,0 +1,26 @@
+// Заглушка Arduino для сборки библиотеки на хосте (extras/host_test)
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+
+#define F(x) x
+#define IRAM_ATTR
+
+// Отладочный вывод библиотеки печатается, только если задана переменная окружения HOST_TEST_VERBOSE
+extern bool host_serial_verbose;
+struct HostSerial
+{
+    template <class... A>
+    int printf(const char *format, A... args) { return host_serial_verbose ? ::printf(format, args...) : 0; }
+    void print(const char *text) { if (host_serial_verbose) ::printf("%s", text); }
+    void print(char c) { if (host_serial_verbose) ::printf("%c", c); }
+    void println(const char *text) { if (host_serial_verbose) ::printf("%s\n", text); }
+    void println() { if (host_serial_verbose) ::printf("\n"); }
+};
+extern HostSerial Serial;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
@@ -0,0 +1,141 @@
+// Заглушка PJON для сборки библиотеки на хосте (extras/host_test).
+// Кадр в эфире: [ID получателя][ID отправителя][данные]. ACK PJON не моделируется:
+// флаг set_acknowledge() только записывается в эфир, чтобы тест видел, какие передачи ждали бы ответа.
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define PJON_NOT_ASSIGNED 255
+#define PJON_BROADCAST_ADDRESS 0
+#define PJON_ACK 6
+#define PJON_BUSY 666
+#define PJON_FAIL 65535
+#define PJON_CONNECTION_LOST 101
+#define PJON_PACKETS_BUFFER_FULL 102
+#define PJON_CONTENT_TOO_LONG 104
+#define PJON_HOST_MAX_FRAME 250
+#define PJON_HOST_MAX_PACKETS 8
+
+struct PJON_Packet_Info
+{
+    uint8_t sender_id;
+    uint8_t sender_ethernet_address[6];
+    uint8_t header;
+};
+typedef void (*PJON_Receiver)(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info);
+typedef void (*PJON_Error)(uint8_t code, uint16_t data, void *custom_pointer);
+
+// Передача кадра в эфир тестовой среды (host_stubs.cpp)
+void host_radio_send(const uint8_t *dst_mac, const uint8_t *frame, uint16_t length, bool ack_requested);
+
+template <typename S>
+class PJON
+{
+public:
+    S strategy;
+
+    PJON() : _id(PJON_NOT_ASSIGNED), _receiver_id(PJON_BROADCAST_ADDRESS), _ack(true), _listening(false),
+             _receiver(nullptr), _error(nullptr), _packet_count(0) { memset(_bus, 0, sizeof(_bus)); }
+
+    void set_id(uint8_t id) { _id = id; }
+    uint8_t device_id() const { return _id; }
+    const uint8_t *bus_id() const { return _bus; }
+    void set_bus_id(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3)
+    {
+        _bus[0] = b0;
+        _bus[1] = b1;
+        _bus[2] = b2;
+        _bus[3] = b3;
+    }
+    void set_receiver(PJON_Receiver receiver) { _receiver = receiver; }
+    void set_error(PJON_Error error) { _error = error; }
+    void set_receiver_id(uint8_t id) { _receiver_id = id; }
+    void set_acknowledge(bool enabled) { _ack = enabled; }
+    void begin() { _listening = true; }
+    void end()
+    {
+        _listening = false;
+        _packet_count = 0;
+    }
+    bool is_listening() const { return _listening; }
+
+    uint16_t send_packet(const void *payload, uint16_t length)
+    {
+        if (length + 2 > PJON_HOST_MAX_FRAME)
+            return PJON_FAIL;
+        uint8_t frame[PJON_HOST_MAX_FRAME];
+        frame[0] = _receiver_id;
+        frame[1] = _id;
+        memcpy(frame + 2, payload, length);
+        host_radio_send(strategy.receiver_mac(), frame, length + 2, _ack && _receiver_id != PJON_BROADCAST_ADDRESS);
+        return PJON_ACK;
+    }
+
+    // Как в PJON, send() только кладет пакет в буфер; отправляет его update()
+    uint16_t send(const void *payload, uint16_t length)
+    {
+        if (_packet_count >= PJON_HOST_MAX_PACKETS || length + 2 > PJON_HOST_MAX_FRAME)
+            return PJON_FAIL;
+        Packet &packet = _packets[_packet_count];
+        memcpy(packet.mac, strategy.receiver_mac(), 6);
+        packet.receiver_id = _receiver_id;
+        packet.ack = _ack;
+        packet.length = length;
+        memcpy(packet.data, payload, length);
+        return _packet_count++;
+    }
+
+    uint8_t update()
+    {
+        uint8_t sent = _packet_count;
+        for (uint8_t i = 0; i < sent; ++i)
+        {
+            Packet &packet = _packets[i];
+            uint8_t frame[PJON_HOST_MAX_FRAME];
+            frame[0] = packet.receiver_id;
+            frame[1] = _id;
+            memcpy(frame + 2, packet.data, packet.length);
+            host_radio_send(packet.mac, frame, packet.length + 2, packet.ack && packet.receiver_id != PJON_BROADCAST_ADDRESS);
+        }
+        _packet_count = 0;
+        return 0;
+    }
+
+    uint16_t receive()
+    {
+        uint8_t frame[PJON_HOST_MAX_FRAME];
+        uint8_t mac[6];
+        uint16_t length = strategy.take_frame(frame, mac);
+        if (length < 2)
+            return PJON_FAIL;
+        if (frame[0] != _id && frame[0] != PJON_BROADCAST_ADDRESS)
+            return PJON_BUSY;
+        PJON_Packet_Info info;
+        info.sender_id = frame[1];
+        memcpy(info.sender_ethernet_address, mac, 6);
+        info.header = 0;
+        if (_receiver)
+            _receiver(frame + 2, length - 2, info);
+        return PJON_ACK;
+    }
+    uint16_t receive(uint32_t) { return receive(); }
+
+private:
+    struct Packet
+    {
+        uint8_t mac[6];
+        uint8_t receiver_id;
+        bool ack;
+        uint16_t length;
+        uint8_t data[PJON_HOST_MAX_FRAME];
+    };
+    uint8_t _id;
+    uint8_t _bus[4];
+    uint8_t _receiver_id;
+    bool _ack;
+    bool _listening;
+    PJON_Receiver _receiver;
+    PJON_Error _error;
+    Packet _packets[PJON_HOST_MAX_PACKETS];
+    uint8_t _packet_count;
+};
@@ -0,0 +1,8 @@
+#pragma once
+#define WIFI_STA 1
+struct HostWiFi
+{
+    void disconnect(bool) {}
+    bool mode(int) { return true; }
+};
+extern HostWiFi WiFi;
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_MAX_DATA_LEN 250
+#define ESP_NOW_MAX_TOTAL_PEER_NUM 20
+#define ESP_NOW_MAX_ENCRYPT_PEER_NUM 6
+#define ESP_ERR_ESPNOW_FULL 0x3068
+typedef enum { ESP_NOW_SEND_SUCCESS = 0, ESP_NOW_SEND_FAIL } esp_now_send_status_t;
+typedef struct { uint8_t *src_addr; uint8_t *des_addr; void* rx_ctrl; } esp_now_recv_info_t;
+typedef struct { uint8_t peer_addr[6]; uint8_t lmk[16]; uint8_t channel; int ifidx; bool encrypt; void* priv; } esp_now_peer_info_t;
+typedef void (*esp_now_send_cb_t)(const uint8_t*, esp_now_send_status_t);
+typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t*, const uint8_t*, int);
+esp_err_t esp_now_init(); esp_err_t esp_now_deinit();
+esp_err_t esp_now_set_pmk(const uint8_t*);
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t); esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t);
+esp_err_t esp_now_unregister_send_cb(); esp_err_t esp_now_unregister_recv_cb();
+bool esp_now_is_peer_exist(const uint8_t*);
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t*); esp_err_t esp_now_mod_peer(const esp_now_peer_info_t*); esp_err_t esp_now_del_peer(const uint8_t*);
@@ -0,0 +1,7 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+typedef enum { WIFI_IF_STA = 0 } wifi_interface_t;
+typedef enum { WIFI_SECOND_CHAN_NONE = 0 } wifi_second_chan_t;
+esp_err_t esp_wifi_get_mac(wifi_interface_t, uint8_t*);
+esp_err_t esp_wifi_set_channel(uint8_t, wifi_second_chan_t);
@@ -0,0 +1,9 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+typedef struct { uint32_t x; } mbedtls_sha1_context;
+void mbedtls_sha1_init(mbedtls_sha1_context *ctx);
+int mbedtls_sha1_starts_ret(mbedtls_sha1_context *ctx);
+int mbedtls_sha1_update_ret(mbedtls_sha1_context *ctx, const unsigned char *data, size_t length);
+int mbedtls_sha1_finish_ret(mbedtls_sha1_context *ctx, unsigned char *out);
+void mbedtls_sha1_free(mbedtls_sha1_context *ctx);
@@ -0,0 +1,41 @@
+// Заглушка стратегии ESPNOW: один буфер приема, как в стратегии PJON
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+class ESPNOW
+{
+public:
+    ESPNOW() : _rx_length(0)
+    {
+        memset(_receiver_mac, 0xFF, sizeof(_receiver_mac));
+        memset(_rx_mac, 0, sizeof(_rx_mac));
+    }
+    void set_channel(uint8_t) {}
+    void set_receiver_mac(const uint8_t *mac) { memcpy(_receiver_mac, mac, 6); }
+    const uint8_t *receiver_mac() const { return _receiver_mac; }
+    void esp_now_send_callback(const uint8_t *, int) {}
+    void esp_now_receive_callback(const uint8_t *mac, const uint8_t *data, int length)
+    {
+        if (length <= 0 || length > (int)sizeof(_rx_data))
+            return;
+        memcpy(_rx_mac, mac, 6);
+        memcpy(_rx_data, data, length);
+        _rx_length = (uint16_t)length;
+    }
+    // Забирает принятый кадр; 0 - буфер пуст
+    uint16_t take_frame(uint8_t *data, uint8_t *mac)
+    {
+        uint16_t length = _rx_length;
+        memcpy(data, _rx_data, length);
+        memcpy(mac, _rx_mac, 6);
+        _rx_length = 0;
+        return length;
+    }
+
+private:
+    uint8_t _receiver_mac[6];
+    uint8_t _rx_mac[6];
+    uint8_t _rx_data[250];
+    uint16_t _rx_length;
+};
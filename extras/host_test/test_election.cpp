@@ -0,0 +1,204 @@
+// Поиск шлюза и выборы: узел находит работающий шлюз запросом GATEWAY_SOLICIT, шлюз объявляет себя по таймеру Trickle;
+// в сети из 50 устройств, стартовавших одновременно, побеждает наибольший приоритет, при равенстве - наименьший MAC,
+// и все узлы подключаются к одному шлюзу
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const uint8_t OP_GATEWAY_ANNOUNCE = 0xD1;
+static const uint8_t OP_GATEWAY_SOLICIT = 0xDF;
+
+static void testNodeSolicitsRunningGateway()
+{
+    host_reset(7);
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    net.add(&gw, GW_MAC);
+    net.select(0);
+    gw.begin("host-test", 1);
+    for (int i = 0; i < 4000 && gw.getRole() != ROLE_GATEWAY; ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    // Периодическое объявление только что отправлено: без запроса узел ждал бы следующего
+    net.run(200);
+
+    host_air.clear();
+    net.add(&node, NODE_MAC);
+    net.select(1);
+    node.begin("host-test", 1);
+    uint64_t started_us = host_time_us;
+    for (int i = 0; i < 2000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(node.getRole() == ROLE_NODE);
+    HOST_CHECK(host_time_us - started_us < 500000ULL);
+
+    bool solicited = false;
+    for (const HostFrame &frame : host_air)
+    {
+        solicited = solicited || (frame.length > 2 && frame.data[2] == OP_GATEWAY_SOLICIT);
+    }
+    HOST_CHECK(solicited);
+}
+
+// Широковещательные объявления в эфире; ответы на GATEWAY_SOLICIT адресные и не считаются
+static int broadcastAnnounces()
+{
+    static const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    int count = 0;
+    for (const HostFrame &frame : host_air)
+    {
+        if (frame.length > 2 && frame.data[2] == OP_GATEWAY_ANNOUNCE && memcmp(frame.dst_mac, broadcast_mac, 6) == 0)
+            count++;
+    }
+    return count;
+}
+
+static void testAnnounceIntervalBacksOffAndResets()
+{
+    host_reset(8);
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    net.add(&gw, GW_MAC);
+    net.select(0);
+    gw.begin("host-test", 1);
+    for (int i = 0; i < 4000 && gw.getRole() != ROLE_GATEWAY; ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+
+    // После старта интервал начинается с 200 мс и удваивается
+    host_air.clear();
+    net.run(3000);
+    HOST_CHECK(broadcastAnnounces() >= 3);
+
+    // В спокойной сети объявления идут через 5..10 с: случайный момент во второй половине потолка (10 с по умолчанию)
+    net.run(60000, 20);
+    host_air.clear();
+    net.run(60000, 20);
+    HOST_CHECK(broadcastAnnounces() >= 6 && broadcastAnnounces() <= 12);
+
+    // Подключение узла сбрасывает интервал: объявления снова идут часто
+    host_air.clear();
+    net.add(&node, NODE_MAC);
+    net.select(1);
+    node.begin("host-test", 1);
+    net.run(1500);
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(broadcastAnnounces() >= 2);
+}
+
+static const uint8_t DEVICE_COUNT = 50;
+
+struct Device
+{
+    ROKOR_Mesh mesh;
+    uint8_t mac[6];
+    uint8_t priority;
+};
+
+// MAC перемешаны относительно порядка запуска; при levels = 5 наибольший приоритет 4 у каждого пятого устройства
+static void makeDevices(Device *devices, uint32_t seed, uint8_t levels)
+{
+    for (uint8_t i = 0; i < DEVICE_COUNT; ++i)
+    {
+        uint8_t mac_low = (uint8_t)((i * 37 + seed * 11) % 251);
+        const uint8_t mac[6] = {0x24, 0x6F, 0x28, (uint8_t)seed, (uint8_t)(i & 1), mac_low};
+        memcpy(devices[i].mac, mac, 6);
+        devices[i].priority = (uint8_t)((i + seed) % levels);
+    }
+}
+
+static int expectedWinner(const Device *devices)
+{
+    int winner = 0;
+    for (int i = 1; i < DEVICE_COUNT; ++i)
+    {
+        if (devices[i].priority > devices[winner].priority ||
+            (devices[i].priority == devices[winner].priority && memcmp(devices[i].mac, devices[winner].mac, 6) < 0))
+            winner = i;
+    }
+    return winner;
+}
+
+static void runElection(uint32_t seed, uint8_t levels)
+{
+    host_reset(seed);
+    HostNet net;
+    Device *devices = new Device[DEVICE_COUNT];
+    makeDevices(devices, seed, levels);
+    for (uint8_t i = 0; i < DEVICE_COUNT; ++i)
+    {
+        net.add(&devices[i].mesh, devices[i].mac);
+    }
+    for (uint8_t i = 0; i < DEVICE_COUNT; ++i)
+    {
+        net.select(i);
+        devices[i].mesh.setGatewayPriority(devices[i].priority);
+        devices[i].mesh.begin("host-election", 1);
+    }
+
+    bool settled = false;
+    for (int step = 0; step < 12000 && !settled; ++step) // до 60 с
+    {
+        net.step(5);
+        settled = true;
+        for (int i = 0; i < DEVICE_COUNT; ++i)
+        {
+            settled = settled && (devices[i].mesh.getRole() == ROLE_GATEWAY || devices[i].mesh.isGatewayConnected());
+        }
+    }
+    net.run(1000);
+
+    int winner = expectedWinner(devices);
+    int gateways = 0;
+    for (int i = 0; i < DEVICE_COUNT; ++i)
+    {
+        gateways += devices[i].mesh.getRole() == ROLE_GATEWAY;
+    }
+    HOST_CHECK(settled);
+    HOST_CHECK(gateways == 1);
+    HOST_CHECK(devices[winner].mesh.getRole() == ROLE_GATEWAY);
+    uint8_t gateway_id = devices[winner].mesh.getPjonId();
+    int agreeing = 0;
+    for (int i = 0; i < DEVICE_COUNT; ++i)
+    {
+        if (i != winner)
+            agreeing += devices[i].mesh.getRole() == ROLE_NODE && devices[i].mesh.isGatewayConnected() &&
+                        devices[i].mesh.getGatewayId() == gateway_id;
+    }
+    HOST_CHECK(agreeing == DEVICE_COUNT - 1);
+    HOST_CHECK(devices[winner].mesh.getNodeCount() == DEVICE_COUNT - 1);
+    delete[] devices;
+}
+
+static void testTopPriorityLowestMacWins() { runElection(1, 5); }
+static void testOtherLayoutSameRule() { runElection(2, 5); }
+static void testEqualPrioritiesLowestMacWins() { runElection(3, 1); }
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"node solicits running gateway", testNodeSolicitsRunningGateway},
+        {"announce interval backs off and resets", testAnnounceIntervalBacksOffAndResets},
+        {"top priority, lowest mac wins", testTopPriorityLowestMacWins},
+        {"other layout, same rule", testOtherLayoutSameRule},
+        {"equal priorities, lowest mac wins", testEqualPrioritiesLowestMacWins},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// Фрагментация: длинное сообщение собирается на приемнике, кадры за пределами буфера сборки отбрасываются
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const uint8_t OP_FRAGMENT = 0xDA;
+static const uint8_t OP_APP_MESSAGE = 0xDE;
+static const uint8_t APP_HEADER_LEN = 2; // Фрагментами передается сообщение вместе с заголовком [APP_MESSAGE][тип]
+static const uint8_t FRAGMENT_HEADER_LEN = 5; // type, msg_id, index, count, flags
+static const uint16_t FRAGMENT_DATA_SIZE = ROKOR_MESH_MAX_PAYLOAD_SIZE - FRAGMENT_HEADER_LEN;
+static const uint16_t FRAGMENT_MESSAGE_SIZE = ROKOR_MESH_MAX_MESSAGE_SIZE + APP_HEADER_LEN;
+static const uint8_t FRAGMENT_COUNT = (FRAGMENT_MESSAGE_SIZE + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+
+struct TxLog
+{
+    int acks;
+    int fails;
+};
+
+struct RxLog
+{
+    int count;
+    uint16_t last_length;
+    bool last_matches;
+};
+
+static uint8_t pattern(uint16_t offset) { return (uint8_t)(offset * 7 + 3); }
+
+// Байт собираемого сообщения: заголовок приложения, затем данные
+static uint8_t messageByte(uint16_t offset)
+{
+    if (offset == 0)
+        return OP_APP_MESSAGE;
+    if (offset == 1)
+        return ROKOR_MESH_DEFAULT_MESSAGE_TYPE;
+    return pattern(offset - APP_HEADER_LEN);
+}
+
+static void onTxComplete(ROKOR_Mesh_TxHandle, uint8_t, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    TxLog *log = (TxLog *)custom_ptr;
+    if (status == TX_STATUS_ACK)
+        log->acks++;
+    else
+        log->fails++;
+}
+
+static void onReceive(uint8_t, const uint8_t *payload, uint16_t length, void *custom_ptr)
+{
+    RxLog *log = (RxLog *)custom_ptr;
+    log->count++;
+    log->last_length = length;
+    log->last_matches = true;
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        log->last_matches = log->last_matches && payload[i] == pattern(i);
+    }
+}
+
+// Отправка фрагментов не включает ACK PJON для последующих передач
+static bool noPjonAckRequested()
+{
+    for (const HostFrame &frame : host_air)
+    {
+        if (frame.ack_requested)
+            return false;
+    }
+    return true;
+}
+
+static void setupPair(HostNet &net, ROKOR_Mesh &gw, ROKOR_Mesh &node, TxLog &tx, RxLog &rx)
+{
+    host_reset(5);
+    net.add(&gw, GW_MAC);
+    net.add(&node, NODE_MAC);
+
+    net.select(0);
+    gw.begin("host-test", 1);
+    gw.setReceiveCallback(onReceive, &rx);
+    net.run(2000);
+    net.select(1);
+    node.begin("host-test", 1);
+    node.setTxCompleteCallback(onTxComplete, &tx);
+
+    for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    net.run(200);
+}
+
+// Кадр FRAGMENT от узла попадает прямо в прием шлюза, минуя очередь отправки узла
+static void injectFragment(HostNet &net, uint8_t node_id, uint8_t msg_id, uint8_t index, uint16_t data_length)
+{
+    uint8_t frame[2 + FRAGMENT_HEADER_LEN + FRAGMENT_DATA_SIZE];
+    frame[0] = ROKOR_MESH_DEFAULT_GATEWAY_ID;
+    frame[1] = node_id;
+    frame[2] = OP_FRAGMENT;
+    frame[3] = msg_id;
+    frame[4] = index;
+    frame[5] = FRAGMENT_COUNT;
+    frame[6] = 0;
+    for (uint16_t i = 0; i < data_length; ++i)
+    {
+        frame[2 + FRAGMENT_HEADER_LEN + i] = messageByte((uint16_t)index * FRAGMENT_DATA_SIZE + i);
+    }
+    net.select(0);
+    host_deliver(NODE_MAC, frame, 2 + FRAGMENT_HEADER_LEN + data_length);
+    net.update(0);
+}
+
+static void testLongMessageIsReassembled()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    TxLog tx = {};
+    RxLog rx = {};
+    setupPair(net, gw, node, tx, rx);
+
+    static uint8_t message[ROKOR_MESH_MAX_MESSAGE_SIZE];
+    for (uint16_t i = 0; i < sizeof(message); ++i)
+    {
+        message[i] = pattern(i);
+    }
+    net.select(1);
+    HOST_CHECK(node.enqueueMessage(ROKOR_MESH_DEFAULT_GATEWAY_ID, message, sizeof(message)) != ROKOR_MESH_INVALID_TX_HANDLE);
+    net.run(2000);
+
+    HOST_CHECK(tx.acks == 1);
+    HOST_CHECK(rx.count == 1);
+    HOST_CHECK(rx.last_length == sizeof(message) && rx.last_matches);
+
+    HOST_CHECK(node.enqueueMessage(ROKOR_MESH_DEFAULT_GATEWAY_ID, message, 8) != ROKOR_MESH_INVALID_TX_HANDLE);
+    net.run(200);
+    HOST_CHECK(tx.acks == 2);
+    HOST_CHECK(rx.count == 2);
+    HOST_CHECK(noPjonAckRequested());
+}
+
+static void testOversizedLastFragmentIsRejected()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    TxLog tx = {};
+    RxLog rx = {};
+    setupPair(net, gw, node, tx, rx);
+    uint8_t node_id = node.getPjonId();
+
+    // Последний фрагмент полной длины вышел бы за буфер сборки
+    uint16_t last_length = FRAGMENT_MESSAGE_SIZE - (FRAGMENT_COUNT - 1) * FRAGMENT_DATA_SIZE;
+    HOST_CHECK(last_length < FRAGMENT_DATA_SIZE);
+    for (uint8_t index = 0; index < FRAGMENT_COUNT - 1; ++index)
+    {
+        injectFragment(net, node_id, 9, index, FRAGMENT_DATA_SIZE);
+    }
+    injectFragment(net, node_id, 9, FRAGMENT_COUNT - 1, FRAGMENT_DATA_SIZE);
+    HOST_CHECK(rx.count == 0);
+
+    // Сборка не повреждена: фрагмент допустимой длины завершает сообщение
+    injectFragment(net, node_id, 9, FRAGMENT_COUNT - 1, last_length);
+    HOST_CHECK(rx.count == 1);
+    HOST_CHECK(rx.last_length == ROKOR_MESH_MAX_MESSAGE_SIZE && rx.last_matches);
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"long message is reassembled", testLongMessageIsReassembled},
+        {"oversized last fragment is rejected", testOversizedLastFragmentIsRejected},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
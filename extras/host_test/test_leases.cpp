@@ -0,0 +1,204 @@
+// Аренды шлюза в NVS: восстановление после перезагрузки, заголовок [версия][число], усечение лишних записей
+// и быстрое переподключение узла к перезагруженному шлюзу
+#include "host_net.h"
+#include "nvs.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const char *NVS_NAMESPACE = "rokor_mesh";
+static const char *NVS_KEY_LEASES = "gw_leases";
+static const uint8_t RECORD_LEN = 7;
+
+// Записи [ID][MAC] для узлов с ID 2, 3, ...
+static std::vector<uint8_t> makeRecords(uint16_t count)
+{
+    std::vector<uint8_t> records;
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        const uint8_t record[RECORD_LEN] = {(uint8_t)(2 + i), 0x24, 0x6F, 0x28, 0x00, (uint8_t)(i >> 8), (uint8_t)(0x10 + i)};
+        records.insert(records.end(), record, record + RECORD_LEN);
+    }
+    return records;
+}
+
+static void writeLeases(ROKOR_Mesh &gw, const std::vector<uint8_t> &blob)
+{
+    host_select(&gw, GW_MAC);
+    nvs_handle_t handle;
+    nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    nvs_set_blob(handle, NVS_KEY_LEASES, blob.data(), blob.size());
+    nvs_close(handle);
+}
+
+static std::vector<uint8_t> readLeases(ROKOR_Mesh &gw)
+{
+    host_select(&gw, GW_MAC);
+    nvs_handle_t handle;
+    nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    size_t length = 0;
+    std::vector<uint8_t> blob;
+    if (nvs_get_blob(handle, NVS_KEY_LEASES, nullptr, &length) == ESP_OK)
+    {
+        blob.resize(length);
+        nvs_get_blob(handle, NVS_KEY_LEASES, blob.data(), &length);
+    }
+    nvs_close(handle);
+    return blob;
+}
+
+// Устройство выигрывает выборы и сохраняет роль шлюза; после этого в NVS кладется таблица аренд, если она задана
+static void electGateway(const std::vector<uint8_t> &blob)
+{
+    host_reset(3);
+    HostNet net;
+    ROKOR_Mesh gw;
+    net.add(&gw, GW_MAC);
+    net.select(0);
+    gw.begin("host-test", 1);
+    for (int i = 0; i < 4000 && gw.getRole() != ROLE_GATEWAY; ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    net.run(100);
+    if (!blob.empty())
+        writeLeases(gw, blob);
+}
+
+// Шлюз после перезагрузки: роль из NVS, аренды восстанавливаются сразу
+static void restartGateway(HostNet &net, ROKOR_Mesh &gw)
+{
+    net.add(&gw, GW_MAC);
+    net.select(0);
+    gw.begin("host-test", 1);
+    net.run(100);
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+}
+
+static void testLeasesSurviveRestart()
+{
+    electGateway(std::vector<uint8_t>());
+    {
+        HostNet net;
+        ROKOR_Mesh gw;
+        restartGateway(net, gw);
+        const uint8_t mac_a[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x21};
+        const uint8_t mac_b[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x22};
+        HOST_CHECK(gw.registerNode(7, mac_a));
+        HOST_CHECK(gw.registerNode(9, mac_b));
+        // Запись откладывается, пока таблица не успокоится
+        HOST_CHECK(readLeases(gw).empty());
+        net.run(3000);
+        std::vector<uint8_t> blob = readLeases(gw);
+        HOST_CHECK(blob.size() == 2 + 2 * RECORD_LEN);
+        HOST_CHECK(blob.size() > 2 && blob[0] == 1 && blob[1] == 2);
+    }
+
+    HostNet net;
+    ROKOR_Mesh gw;
+    restartGateway(net, gw);
+    const uint8_t mac_b[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x22};
+    HOST_CHECK(gw.getNodeCount() == 2);
+    HOST_CHECK(gw.getNodeIdByMac(mac_b) == 9);
+}
+
+static void testOversizedTableIsTruncated()
+{
+    std::vector<uint8_t> blob = makeRecords(ROKOR_MESH_MAX_NODES + 3);
+    blob.insert(blob.begin(), {1, (uint8_t)(ROKOR_MESH_MAX_NODES + 3)});
+    electGateway(blob);
+    HostNet net;
+    ROKOR_Mesh gw;
+    restartGateway(net, gw);
+    HOST_CHECK(gw.getNodeCount() == ROKOR_MESH_MAX_NODES);
+
+    net.run(3000);
+    blob = readLeases(gw);
+    HOST_CHECK(blob.size() == 2 + ROKOR_MESH_MAX_NODES * RECORD_LEN);
+    HOST_CHECK(blob.size() > 2 && blob[1] == ROKOR_MESH_MAX_NODES);
+}
+
+static void testUnknownVersionIsIgnored()
+{
+    std::vector<uint8_t> blob = makeRecords(2);
+    blob.insert(blob.begin(), {9, 2});
+    electGateway(blob);
+    HostNet net;
+    ROKOR_Mesh gw;
+    restartGateway(net, gw);
+    HOST_CHECK(gw.getNodeCount() == 0);
+
+    net.run(3000);
+    HOST_CHECK(readLeases(gw) == blob);
+}
+
+// Первые два кадра узла (пинги шлюзу) теряются, пока шлюз еще не слушает
+static int dropped_pings;
+static bool dropFirstPings(const HostFrame &frame)
+{
+    if (frame.src_mac[5] != 0x10 || dropped_pings >= 2)
+        return false;
+    dropped_pings++;
+    return true;
+}
+
+// Узел и шлюз перезагружаются вместе: узел проверяет сохраненный шлюз частыми пингами, шлюз узнает его по аренде
+static void testNodeRejoinsRebootedGateway()
+{
+    const uint8_t node_mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+    electGateway(std::vector<uint8_t>());
+    uint8_t node_id;
+    {
+        HostNet net;
+        ROKOR_Mesh gw, node;
+        restartGateway(net, gw);
+        net.add(&node, node_mac);
+        net.select(1);
+        node.begin("host-test", 1);
+        for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+        {
+            net.step(5);
+        }
+        HOST_CHECK(node.isGatewayConnected());
+        node_id = node.getPjonId();
+        net.run(3000);
+    }
+
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    restartGateway(net, gw);
+    HOST_CHECK(gw.getNodeIdByMac(node_mac) == node_id);
+    net.add(&node, node_mac);
+    net.select(1);
+    node.begin("host-test", 1);
+    uint64_t started_us = host_time_us;
+    dropped_pings = 0;
+    for (int i = 0; i < 400 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5, dropFirstPings);
+    }
+    HOST_CHECK(dropped_pings == 2);
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(host_time_us - started_us <= 700000ULL);
+    HOST_CHECK(node.getPjonId() == node_id);
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"leases survive restart", testLeasesSurviveRestart},
+        {"oversized table is truncated", testOversizedTableIsTruncated},
+        {"unknown version is ignored", testUnknownVersionIsIgnored},
+        {"node rejoins rebooted gateway", testNodeRejoinsRebootedGateway},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
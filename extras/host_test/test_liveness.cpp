@@ -0,0 +1,121 @@
+// Маяк активности: узел, забытый шлюзом, регистрируется заново, но не на каждый маяк, а с растущей случайной задержкой,
+// и сохраняет прежний ID, только если тот можно выдать
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const uint8_t OP_NODE_ID_REQUEST = 0xD2;
+static const uint8_t OP_NODE_ID_ASSIGN = 0xD3;
+
+static bool isFrame(const HostFrame &frame, const uint8_t *src_mac, uint8_t opcode)
+{
+    return frame.length > 2 && frame.data[2] == opcode && memcmp(frame.src_mac, src_mac, 6) == 0;
+}
+
+static size_t countFrames(size_t from, const uint8_t *src_mac, uint8_t opcode)
+{
+    size_t count = 0;
+    for (size_t i = from; i < host_air.size(); ++i)
+    {
+        count += isFrame(host_air[i], src_mac, opcode);
+    }
+    return count;
+}
+
+static bool dropNodeFrames(const HostFrame &frame) { return memcmp(frame.src_mac, NODE_MAC, 6) == 0; }
+
+// Шлюз с маяком и коротким сроком узла, узел подключен
+static void setupPair(HostNet &net, ROKOR_Mesh &gw, ROKOR_Mesh &node)
+{
+    host_reset(6);
+    net.add(&gw, GW_MAC);
+    net.add(&node, NODE_MAC);
+
+    net.select(0);
+    gw.setGatewayPriority(10);
+    gw.setLivenessBeacon(500);
+    gw.setNodeInactivityTimeout(2000);
+    gw.begin("host-test", 1);
+    net.select(1);
+    node.setNodePingGatewayInterval(20000); // Пинги не подтверждают забытый узел: в окне теста узел остается подключенным
+    node.begin("host-test", 1);
+    for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(gw.getNodeCount() == 1);
+}
+
+static void testForgottenNodeReregistersWithBackoff()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    setupPair(net, gw, node);
+
+    // Запросы узла теряются; шлюз удаляет узел по сроку, а узел получает маяки без своего бита
+    size_t first_frame = host_air.size();
+    net.run(4000, 5, dropNodeFrames);
+    HOST_CHECK(gw.getNodeCount() == 0);
+    HOST_CHECK(countFrames(first_frame, NODE_MAC, OP_NODE_ID_REQUEST) >= 1);
+    size_t window_frame = host_air.size();
+    net.run(10000, 5, dropNodeFrames);
+    size_t requests = countFrames(window_frame, NODE_MAC, OP_NODE_ID_REQUEST);
+    HOST_CHECK(requests >= 2 && requests <= 8); // 20 маяков за окно, запросы не чаще раза в 2..4 с
+    HOST_CHECK(node.isGatewayConnected());
+
+    // Связь восстановилась: очередной повтор возвращает узел в таблицу с прежним ID
+    size_t restore_frame = host_air.size();
+    uint8_t node_id = node.getPjonId();
+    net.run(5000);
+    HOST_CHECK(countFrames(restore_frame, GW_MAC, OP_NODE_ID_ASSIGN) >= 1);
+    HOST_CHECK(node.isGatewayConnected() && node.getPjonId() == node_id);
+}
+
+// Прежний ID сохраняется только по правилам выдачи: зарезервированный приложением или служебный ID не возвращается
+static void testReservedIdIsNotKept()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    setupPair(net, gw, node);
+    uint8_t node_id = node.getPjonId();
+
+    net.run(4000, 5, dropNodeFrames);
+    HOST_CHECK(gw.getNodeCount() == 0);
+    net.select(0);
+    HOST_CHECK(gw.reserveNodeIds(node_id, node_id));
+
+    net.run(5000);
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(node.getPjonId() != node_id && node.getPjonId() != PJON_NOT_ASSIGNED);
+    HOST_CHECK(gw.getNodeIdByMac(NODE_MAC) == node.getPjonId());
+
+    // Запрос от имени ID шлюза по умолчанию тоже получает новый ID
+    const uint8_t other_mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x20};
+    uint8_t frame[3 + 6] = {ROKOR_MESH_DEFAULT_GATEWAY_ID, ROKOR_MESH_DEFAULT_GATEWAY_ID, OP_NODE_ID_REQUEST};
+    memcpy(&frame[3], other_mac, 6);
+    net.select(0);
+    host_deliver(other_mac, frame, sizeof(frame));
+    net.update(0);
+    uint8_t other_id = gw.getNodeIdByMac(other_mac);
+    HOST_CHECK(other_id != PJON_NOT_ASSIGNED && other_id != ROKOR_MESH_DEFAULT_GATEWAY_ID && other_id != node_id);
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"forgotten node re-registers with backoff", testForgottenNodeReregistersWithBackoff},
+        {"reserved id is not kept", testReservedIdIsNotKept},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
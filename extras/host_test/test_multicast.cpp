@@ -0,0 +1,163 @@
+// Групповая рассылка: MULTICAST_ACK со случайной задержкой, итог ACK только при ответе всех адресатов
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MACS[3][6] = {
+    {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10},
+    {0x24, 0x6F, 0x28, 0x00, 0x00, 0x11},
+    {0x24, 0x6F, 0x28, 0x00, 0x00, 0x12},
+};
+static const uint8_t NODE_COUNT = 3;
+static const uint8_t OP_MULTICAST_ACK = 0xD9;
+
+struct TxLog
+{
+    int acks;
+    int partials;
+    int fails;
+    int member_acks;
+    uint32_t last_status_time;
+};
+
+static void onTxComplete(ROKOR_Mesh_TxHandle, uint8_t, ROKOR_Mesh_TxStatus status, void *custom_ptr)
+{
+    TxLog *log = (TxLog *)custom_ptr;
+    if (status == TX_STATUS_ACK)
+        log->acks++;
+    else if (status == TX_STATUS_PARTIAL)
+        log->partials++;
+    else
+        log->fails++;
+    log->last_status_time = (uint32_t)(host_time_us / 1000);
+}
+
+static void onMulticastAck(ROKOR_Mesh_TxHandle, uint8_t, void *custom_ptr)
+{
+    ((TxLog *)custom_ptr)->member_acks++;
+}
+
+static bool isFrame(const HostFrame &frame, const uint8_t *src_mac, uint8_t opcode)
+{
+    return frame.length > 2 && frame.data[2] == opcode && memcmp(frame.src_mac, src_mac, 6) == 0;
+}
+
+static bool dropAcksFromLastNode(const HostFrame &frame) { return isFrame(frame, NODE_MACS[NODE_COUNT - 1], OP_MULTICAST_ACK); }
+
+// Шлюз и три узла, получившие от него ID
+static void setupGroup(HostNet &net, ROKOR_Mesh &gw, ROKOR_Mesh *nodes, TxLog &tx, uint8_t *ids)
+{
+    host_reset(5);
+    net.add(&gw, GW_MAC);
+    for (uint8_t i = 0; i < NODE_COUNT; ++i)
+    {
+        net.add(&nodes[i], NODE_MACS[i]);
+    }
+
+    net.select(0);
+    gw.begin("host-test", 1);
+    gw.setTxCompleteCallback(onTxComplete, &tx);
+    gw.setMulticastAckCallback(onMulticastAck, &tx);
+    for (int step = 0; step < 4000 && gw.getRole() != ROLE_GATEWAY; ++step)
+    {
+        net.step(5);
+    }
+    for (uint8_t i = 0; i < NODE_COUNT; ++i)
+    {
+        net.select(i + 1);
+        nodes[i].begin("host-test", 1);
+    }
+
+    bool connected = false;
+    for (int step = 0; step < 4000 && !connected; ++step)
+    {
+        net.step(5);
+        connected = true;
+        for (uint8_t i = 0; i < NODE_COUNT; ++i)
+        {
+            connected = connected && nodes[i].isGatewayConnected();
+        }
+    }
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(connected);
+    net.run(200);
+    for (uint8_t i = 0; i < NODE_COUNT; ++i)
+    {
+        ids[i] = nodes[i].getPjonId();
+    }
+}
+
+static void testAllMembersAcknowledge()
+{
+    HostNet net;
+    ROKOR_Mesh gw, nodes[NODE_COUNT];
+    TxLog tx = {};
+    uint8_t ids[NODE_COUNT];
+    setupGroup(net, gw, nodes, tx, ids);
+
+    net.select(0);
+    const uint8_t payload[] = {'g', 'o'};
+    HOST_CHECK(gw.sendToMany(ids, NODE_COUNT, payload, sizeof(payload), true) != ROKOR_MESH_INVALID_TX_HANDLE);
+    net.run(500);
+
+    HOST_CHECK(tx.member_acks == NODE_COUNT);
+    HOST_CHECK(tx.acks == 1);
+    HOST_CHECK(tx.partials == 0 && tx.fails == 0);
+}
+
+static void testMissingMemberReportsPartial()
+{
+    HostNet net;
+    ROKOR_Mesh gw, nodes[NODE_COUNT];
+    TxLog tx = {};
+    uint8_t ids[NODE_COUNT];
+    setupGroup(net, gw, nodes, tx, ids);
+
+    net.select(0);
+    const uint8_t payload[] = {1};
+    gw.sendToMany(ids, NODE_COUNT, payload, sizeof(payload), true);
+    net.run(1000, 5, dropAcksFromLastNode);
+
+    HOST_CHECK(tx.member_acks == NODE_COUNT - 1);
+    HOST_CHECK(tx.acks == 0);
+    HOST_CHECK(tx.partials == 1);
+}
+
+static void testUnregisteredIdIsNotAwaited()
+{
+    HostNet net;
+    ROKOR_Mesh gw, nodes[NODE_COUNT];
+    TxLog tx = {};
+    uint8_t ids[NODE_COUNT + 1];
+    setupGroup(net, gw, nodes, tx, ids);
+    ids[NODE_COUNT] = 200; // Такого узла нет в таблице шлюза
+
+    net.select(0);
+    uint32_t sent_time = (uint32_t)(host_time_us / 1000);
+    const uint8_t payload[] = {2};
+    gw.sendToMany(ids, NODE_COUNT + 1, payload, sizeof(payload), true);
+    net.run(500);
+
+    HOST_CHECK(tx.acks == 1);
+    HOST_CHECK(tx.partials == 0);
+    HOST_CHECK(tx.last_status_time - sent_time < 100); // Итог не ждал окна ответов
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"all members acknowledge", testAllMembersAcknowledge},
+        {"missing member reports partial", testMissingMemberReportsPartial},
+        {"unregistered id is not awaited", testUnregisteredIdIsNotAwaited},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
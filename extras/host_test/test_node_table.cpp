@@ -0,0 +1,231 @@
+// Таблица узлов шлюза: поиск по ID и MAC, регистрация заранее, удаление неактивных узлов и кэш пиров ESP-NOW
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const uint8_t SYNTHETIC_COUNT = ROKOR_MESH_MAX_NODES - 1;
+
+// MAC-адреса отличаются только младшим байтом: худший случай для хеша по MAC
+static void syntheticMac(uint8_t index, uint8_t mac[6])
+{
+    static const uint8_t base[6] = {0x24, 0x6F, 0x28, 0x7F, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[5] = index;
+}
+
+static void startGateway(HostNet &net, ROKOR_Mesh &gw, ROKOR_Mesh &node)
+{
+    host_reset(3);
+    net.add(&gw, GW_MAC);
+    net.add(&node, NODE_MAC);
+    net.select(0);
+    gw.begin("host-test", 1);
+    // Без других устройств шлюз назначает себя после окна поиска и выборов
+    for (int i = 0; i < 4000 && gw.getRole() != ROLE_GATEWAY; ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+}
+
+static void testRegisteredNodesAreFoundByMac()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    startGateway(net, gw, node);
+
+    uint8_t mac[6];
+    for (uint8_t i = 0; i < SYNTHETIC_COUNT; ++i)
+    {
+        syntheticMac(i, mac);
+        HOST_CHECK(gw.registerNode(100 + i, mac));
+    }
+    HOST_CHECK(gw.getNodeCount() == SYNTHETIC_COUNT);
+
+    // Повторная регистрация того же MAC под тем же ID не добавляет узел, занятый чужим MAC ID отклоняется
+    syntheticMac(0, mac);
+    HOST_CHECK(gw.registerNode(100, mac));
+    HOST_CHECK(!gw.registerNode(101, mac));
+    HOST_CHECK(gw.getNodeCount() == SYNTHETIC_COUNT);
+    HOST_CHECK(gw.getNodeIdByMac(mac) == 100);
+
+    // Настоящий узел получает свободный ID и занимает последнее место таблицы
+    net.select(1);
+    node.begin("host-test", 1);
+    for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(gw.getNodeCount() == ROKOR_MESH_MAX_NODES);
+    HOST_CHECK(gw.getNodeIdByMac(NODE_MAC) == node.getPjonId());
+    HOST_CHECK(node.getPjonId() < 100 || node.getPjonId() >= 100 + SYNTHETIC_COUNT);
+}
+
+static void testInactiveNodesAreRemoved()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    startGateway(net, gw, node);
+
+    uint8_t mac[6];
+    for (uint8_t i = 0; i < SYNTHETIC_COUNT; ++i)
+    {
+        syntheticMac(i, mac);
+        HOST_CHECK(gw.registerNode(100 + i, mac));
+    }
+    net.select(1);
+    node.begin("host-test", 1);
+
+    // Синтетические узлы молчат и удаляются по таймауту, настоящий узел отвечает на пинги и остается
+    net.run(200000, 20);
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(gw.getNodeCount() == 1);
+    HOST_CHECK(gw.getNodeIdByMac(NODE_MAC) == node.getPjonId());
+    for (uint8_t i = 0; i < SYNTHETIC_COUNT; ++i)
+    {
+        syntheticMac(i, mac);
+        HOST_CHECK(gw.getNodeIdByMac(mac) == PJON_NOT_ASSIGNED);
+    }
+
+    // Освободившиеся ID и MAC можно зарегистрировать снова
+    syntheticMac(5, mac);
+    HOST_CHECK(gw.registerNode(100, mac));
+    HOST_CHECK(gw.getNodeIdByMac(mac) == 100);
+}
+
+static void testReservedIdsAreSkipped()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    startGateway(net, gw, node);
+
+    uint8_t mac[6];
+    HOST_CHECK(gw.reserveNodeIds(2, 50));
+    syntheticMac(0, mac);
+    uint8_t first = gw.assignNodeId(mac);
+    HOST_CHECK(first == 51);
+    HOST_CHECK(gw.assignNodeId(mac) == first);
+
+    // Снятая резервация не возвращает курсор назад: следующий ID идет за последним выданным
+    gw.clearReservedNodeIds();
+    syntheticMac(1, mac);
+    HOST_CHECK(gw.assignNodeId(mac) == first + 1);
+
+    // Узел, подключившийся по NODE_ID_REQUEST, тоже обходит резервацию
+    HOST_CHECK(gw.reserveNodeIds(first + 2, 200));
+    net.select(1);
+    node.begin("host-test", 1);
+    for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(node.getPjonId() > 200 && node.getPjonId() != PJON_NOT_ASSIGNED);
+    HOST_CHECK(!gw.reserveNodeIds(10, 5));
+}
+
+struct StatusLog
+{
+    int disconnects;
+    uint8_t last_id;
+};
+
+static void onNodeStatus(uint8_t node_id, bool connected, void *custom_ptr)
+{
+    StatusLog *log = (StatusLog *)custom_ptr;
+    if (!connected)
+    {
+        log->disconnects++;
+        log->last_id = node_id;
+    }
+}
+
+static void testSilentNodeTimesOutWithinOneTick()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    StatusLog status = {};
+    startGateway(net, gw, node);
+    gw.setNodeStatusCallback(onNodeStatus, &status);
+    gw.setNodeInactivityTimeout(3000);
+
+    uint8_t mac[6];
+    syntheticMac(0, mac);
+    HOST_CHECK(gw.registerNode(100, mac));
+    uint64_t registered_us = host_time_us;
+    while (gw.getNodeIdByMac(mac) != PJON_NOT_ASSIGNED && host_time_us - registered_us < 10000000ULL)
+    {
+        net.step(5);
+    }
+    uint32_t elapsed_ms = (uint32_t)((host_time_us - registered_us) / 1000);
+    HOST_CHECK(gw.getNodeIdByMac(mac) == PJON_NOT_ASSIGNED);
+    HOST_CHECK(elapsed_ms >= 3000 && elapsed_ms <= 4000 + 5);
+    HOST_CHECK(status.disconnects == 1 && status.last_id == 100);
+    HOST_CHECK(gw.getNodeCount() == 0);
+}
+
+static void onTxComplete(ROKOR_Mesh_TxHandle, uint8_t, ROKOR_Mesh_TxStatus, void *custom_ptr)
+{
+    (*(int *)custom_ptr)++;
+}
+
+static void testPeerCacheEvictsLeastRecentlyUsed()
+{
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    int completed = 0;
+    startGateway(net, gw, node);
+    gw.setTxCompleteCallback(onTxComplete, &completed);
+    gw.setNodeInactivityTimeout(60000);
+    gw.resetPeerCacheStats();
+
+    // Узлов больше, чем пиров ESP-NOW: каждая отправка регистрирует пира и вытесняет давно не использованного
+    uint8_t mac[6];
+    uint8_t payload[4] = {1, 2, 3, 4};
+    for (uint8_t i = 0; i < SYNTHETIC_COUNT; ++i)
+    {
+        syntheticMac(i, mac);
+        HOST_CHECK(gw.registerNode(100 + i, mac));
+        HOST_CHECK(gw.enqueueMessage(100 + i, payload, sizeof(payload)) != ROKOR_MESH_INVALID_TX_HANDLE);
+        // Синтетический узел не отвечает: ждем исчерпания повторов, чтобы не переполнить очередь
+        for (int t = 0; t < 4000 && completed <= i; ++t)
+        {
+            net.step(5);
+        }
+    }
+    ROKOR_Mesh_PeerCacheStats stats;
+    gw.getPeerCacheStats(stats);
+    HOST_CHECK(stats.capacity >= 1 && stats.capacity <= ROKOR_MESH_PEER_CACHE_SIZE);
+    HOST_CHECK(stats.peers == stats.capacity);
+    HOST_CHECK(stats.misses >= SYNTHETIC_COUNT);
+    HOST_CHECK(stats.evictions >= SYNTHETIC_COUNT - stats.capacity);
+
+    // Удаленные по таймауту узлы освобождают свои места в кэше
+    net.run(70000, 20);
+    HOST_CHECK(gw.getNodeCount() == 0);
+    gw.getPeerCacheStats(stats);
+    HOST_CHECK(stats.peers == 0);
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"registered nodes are found by mac", testRegisteredNodesAreFoundByMac},
+        {"inactive nodes are removed", testInactiveNodesAreRemoved},
+        {"reserved ids are skipped", testReservedIdsAreSkipped},
+        {"silent node times out within one tick", testSilentNodeTimesOutWithinOneTick},
+        {"peer cache evicts least recently used", testPeerCacheEvictsLeastRecentlyUsed},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// Резервный шлюз: замена только после пропущенных пульсов и безответных запросов, один шлюз после возврата прежнего
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t STANDBY_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x02};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const size_t GW = 0, STANDBY = 1, NODE = 2;
+static const uint8_t OP_STANDBY_HELLO = 0xE1;
+static const uint8_t OP_GATEWAY_SYNC = 0xE2;
+static const uint8_t HELLO_FLAGS_OFFSET = 2 + 1 + 6 + 2; // [ID получателя][ID отправителя][тип][MAC][synced][номер][flags]
+
+static bool isFrame(const HostFrame &frame, const uint8_t *src_mac, uint8_t opcode)
+{
+    return frame.length > 2 && frame.data[2] == opcode && memcmp(frame.src_mac, src_mac, 6) == 0;
+}
+
+static size_t countProbes(size_t from)
+{
+    size_t count = 0;
+    for (size_t i = from; i < host_air.size(); ++i)
+    {
+        const HostFrame &frame = host_air[i];
+        count += isFrame(frame, STANDBY_MAC, OP_STANDBY_HELLO) && frame.length > HELLO_FLAGS_OFFSET && (frame.data[HELLO_FLAGS_OFFSET] & 0x01);
+    }
+    return count;
+}
+
+static uint32_t drop_sync_until_ms = 0;
+static bool dropGatewaySync(const HostFrame &frame) { return host_time_us / 1000 < drop_sync_until_ms && isFrame(frame, GW_MAC, OP_GATEWAY_SYNC); }
+
+// Шлюз (приоритет 10), синхронизированный резерв и подключенный узел
+static void setupStandby(HostNet &net, ROKOR_Mesh &gw, ROKOR_Mesh &standby, ROKOR_Mesh &node)
+{
+    host_reset(5);
+    net.add(&gw, GW_MAC);
+    net.add(&standby, STANDBY_MAC);
+    net.add(&node, NODE_MAC);
+
+    net.select(GW);
+    gw.setGatewayPriority(10);
+    gw.begin("host-test", 1);
+    for (int i = 0; i < 2000 && gw.getRole() != ROLE_GATEWAY; ++i)
+    {
+        net.step(5);
+    }
+    net.select(STANDBY);
+    standby.setStandbyGateway(true);
+    standby.begin("host-test", 1);
+    net.select(NODE);
+    node.begin("host-test", 1);
+    for (int i = 0; i < 4000 && !(node.isGatewayConnected() && standby.getRole() == ROLE_STANDBY_GATEWAY); ++i)
+    {
+        net.step(5);
+    }
+    net.run(1000);
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(standby.getRole() == ROLE_STANDBY_GATEWAY);
+    HOST_CHECK(node.isGatewayConnected());
+}
+
+static void testMissedHeartbeatsAnsweredByProbe()
+{
+    HostNet net;
+    ROKOR_Mesh gw, standby, node;
+    setupStandby(net, gw, standby, node);
+
+    size_t first_frame = host_air.size();
+    drop_sync_until_ms = (uint32_t)(host_time_us / 1000) + 470; // Пропадают пульсы и ответ на первый запрос
+    net.run(2000, 5, dropGatewaySync);
+
+    HOST_CHECK(countProbes(first_frame) >= 1);
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(standby.getRole() == ROLE_STANDBY_GATEWAY);
+}
+
+static void testSilentGatewayIsReplaced()
+{
+    HostNet net;
+    ROKOR_Mesh gw, standby, node;
+    setupStandby(net, gw, standby, node);
+    uint8_t gateway_id = gw.getPjonId();
+
+    size_t first_frame = host_air.size();
+    net.setPaused(GW, true);
+    net.run(400);
+    HOST_CHECK(standby.getRole() == ROLE_STANDBY_GATEWAY); // Тишина еще не проверена запросами
+    net.run(600);
+
+    HOST_CHECK(countProbes(first_frame) == 3);
+    HOST_CHECK(standby.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(standby.getPjonId() == gateway_id);
+    HOST_CHECK(node.isGatewayConnected() && node.getGatewayId() == gateway_id);
+}
+
+static void testReturningGatewayLeavesOneGateway()
+{
+    HostNet net;
+    ROKOR_Mesh gw, standby, node;
+    setupStandby(net, gw, standby, node);
+
+    net.setPaused(GW, true);
+    net.run(1000);
+    HOST_CHECK(standby.getRole() == ROLE_GATEWAY);
+
+    // Прежний шлюз ожил и шлет пульс бывшему резерву: старший по приоритету остается, резерв возвращается в резерв
+    net.setPaused(GW, false);
+    net.run(2000);
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(standby.getRole() == ROLE_STANDBY_GATEWAY);
+    HOST_CHECK(node.isGatewayConnected() && node.getGatewayId() == gw.getPjonId());
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"missed heartbeats answered by probe", testMissedHeartbeatsAnsweredByProbe},
+        {"silent gateway is replaced", testSilentGatewayIsReplaced},
+        {"returning gateway leaves one gateway", testReturningGatewayLeavesOneGateway},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
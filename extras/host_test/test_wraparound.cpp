@@ -0,0 +1,67 @@
+// Переполнение millis(): таймеры узла и шлюза переживают переход через 2^32 мс
+#include "host_net.h"
+
+static const uint8_t GW_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t NODE_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x10};
+static const uint8_t OP_NODE_PING_GATEWAY = 0xD5;
+static const uint64_t WRAP_MS = 0x100000000ULL;
+
+static size_t countFrames(size_t from, const uint8_t *src_mac, uint8_t opcode)
+{
+    size_t count = 0;
+    for (size_t i = from; i < host_air.size(); ++i)
+    {
+        const HostFrame &frame = host_air[i];
+        count += frame.length > 2 && frame.data[2] == opcode && memcmp(frame.src_mac, src_mac, 6) == 0;
+    }
+    return count;
+}
+
+// Узел подключается за 20 с до переполнения; опрос шлюза раз в 5 с проходит через переход
+static void testGatewayPingAcrossWrap()
+{
+    host_reset(4);
+    host_time_us = (WRAP_MS - 20000) * 1000;
+    HostNet net;
+    ROKOR_Mesh gw, node;
+    net.add(&gw, GW_MAC);
+    net.add(&node, NODE_MAC);
+
+    net.select(0);
+    gw.setGatewayPriority(10);
+    gw.begin("host-test", 1);
+    net.select(1);
+    node.setNodePingGatewayInterval(5000);
+    node.begin("host-test", 1);
+    for (int i = 0; i < 4000 && !node.isGatewayConnected(); ++i)
+    {
+        net.step(5);
+    }
+    HOST_CHECK(node.isGatewayConnected());
+    HOST_CHECK(host_time_us / 1000 < WRAP_MS); // Переход еще впереди
+
+    size_t first_frame = host_air.size();
+    net.run(30000);
+    HOST_CHECK(host_time_us / 1000 > WRAP_MS);
+    HOST_CHECK(countFrames(first_frame, NODE_MAC, OP_NODE_PING_GATEWAY) <= 7);
+    HOST_CHECK(gw.getRole() == ROLE_GATEWAY);
+    HOST_CHECK(node.isGatewayConnected());
+}
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        {"gateway ping across wrap", testGatewayPingAcrossWrap},
+    };
+    for (auto &test : tests)
+    {
+        int failures_before = host_failures;
+        test.run();
+        printf("%s: %s\n", test.name, host_failures == failures_before ? "OK" : "FAILED");
+    }
+    return host_failures == 0 ? 0 : 1;
+}
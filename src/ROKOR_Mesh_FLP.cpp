@@ -31,6 +31,9 @@
 // Определение глобального указателя
 ROKOR_Mesh *global_ROKOR_Mesh_instance = nullptr;
 
+const uint8_t ROKOR_Mesh::_esp_now_broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+const uint8_t ROKOR_Mesh::_esp_now_null_mac[ESP_NOW_ETH_ALEN] = {0, 0, 0, 0, 0, 0};
+
 // Константы для NVS
 const char *NVS_NAMESPACE = "rokor_mesh";
 const char *NVS_KEY_ROLE = "role";
@@ -41,19 +44,86 @@ const char *NVS_KEY_NET_NAME = "net_name";
 const char *NVS_KEY_PMK_STORE = "pmk_val";
 const char *NVS_KEY_GW_ID = "gw_pjonid";
 const char *NVS_KEY_GW_MAC = "gw_mac"; // MAC шлюза, к которому подключен узел
+const char *NVS_KEY_LEASES = "gw_leases"; // Таблица узлов шлюза: [версия][число][записи [ID][MAC]...]
 
 // Таймауты и интервалы по умолчанию (могут быть изменены сеттерами)
 const uint32_t DEFAULT_DISCOVERY_TIMEOUT_MS = 5000;
 const uint32_t DEFAULT_CONTENTION_WINDOW_MS = 1500;
-const uint32_t DEFAULT_GATEWAY_ANNOUNCE_INTERVAL_MS = 10000;
+const uint32_t DEFAULT_GATEWAY_ANNOUNCE_INTERVAL_MS = 10000; // Потолок Trickle; увеличивается через setGatewayAnnounceInterval(), когда все узлы ищут шлюз запросом
 const uint32_t DEFAULT_NODE_PING_INTERVAL_MS = 30000;
 const uint8_t DEFAULT_NODE_MAX_PING_ATTEMPTS = 3;
 const uint32_t GATEWAY_MIN_ANNOUNCE_INTERVAL_MS = 2000;
 const uint32_t NODE_ID_REQUEST_TIMEOUT_MS = 5000;
-const uint32_t NODE_CLEANUP_INTERVAL_MS = (DEFAULT_NODE_PING_INTERVAL_MS * (DEFAULT_NODE_MAX_PING_ATTEMPTS + 2)) + 10000;
-const uint32_t NODE_INACTIVITY_THRESHOLD_MS = DEFAULT_NODE_PING_INTERVAL_MS * (DEFAULT_NODE_MAX_PING_ATTEMPTS + 1);
-
-const uint8_t PJON_RX_WAIT_TIME = 10; // ms, время ожидания для PJON receive
+// Повтор NODE_ID_REQUEST через случайную задержку в [окно/2, окно]; окно удваивается от MIN до MAX, чтобы узлы,
+// разом потерявшие регистрацию (перезагрузка шлюза без аренд), не заваливали шлюз запросами
+const uint32_t NODE_ID_RETRY_MIN_MS = 500;
+const uint32_t NODE_ID_RETRY_MAX_MS = 4000;
+const uint32_t GATEWAY_SOLICIT_INTERVAL_MS = 500; // Повтор GATEWAY_SOLICIT, пока узел ищет шлюз
+const uint32_t GATEWAY_SOLICIT_JITTER_MS = 250;   // ...плюс случайная добавка: узлы, включенные разом, не шлют запросы синхронно
+const uint32_t SOLICIT_REPLY_JITTER_MS = 20;      // Наибольшая задержка ответа шлюза на GATEWAY_SOLICIT
+// GATEWAY_ANNOUNCE по таймеру Trickle: при изменениях в сети интервал сбрасывается к ANNOUNCE_TRICKLE_MIN_INTERVAL_MS,
+// в спокойной сети удваивается до setGatewayAnnounceInterval()
+const uint32_t ANNOUNCE_TRICKLE_MIN_INTERVAL_MS = 200;
+// Выборы шлюза: кандидаты повторяют GATEWAY_CLAIM в течение окна setGatewayContentionWindow()
+const uint32_t ELECTION_CLAIM_INTERVAL_MS = 100;
+const uint32_t ELECTION_CLAIM_JITTER_MS = 50;
+// Быстрое переподключение к сохраненному шлюзу: пауза после пинга удваивается с REJOIN_FIRST_RETRY_MS;
+// без ответа на REJOIN_MAX_PROBES пингов (~620 мс) узел переходит к поиску шлюза
+const uint32_t REJOIN_FIRST_RETRY_MS = 20;
+const uint8_t REJOIN_MAX_PROBES = 5;
+const uint32_t LEASE_SAVE_QUIET_MS = 2000;      // Запись аренд после паузы в изменениях таблицы узлов
+const uint32_t LEASE_SAVE_MAX_DELAY_MS = 30000; // ...но не позже, чем через это время после первого изменения
+const uint32_t LIVENESS_TICK_MS = 1000; // Шаг колеса таймеров: отключение узла обнаруживается не позже чем через такт
+// Маяк активности шлюза: узел, не получивший LIVENESS_BEACON_MISSED_LIMIT маяков подряд, сразу проверяет шлюз
+const uint32_t LIVENESS_BEACON_MIN_INTERVAL_MS = 500;
+const uint32_t LIVENESS_BEACON_MAX_INTERVAL_MS = 65535; // Период передается в маяке двумя байтами
+const uint8_t LIVENESS_BEACON_MISSED_LIMIT = 3;
+const uint8_t PING_FLAG_REPLY = 0x01;
+// Резервный шлюз: пульс шлюза каждые STANDBY_HEARTBEAT_MS. После STANDBY_TAKEOVER_MS тишины (4 пропущенных пульса)
+// резерв запрашивает шлюз STANDBY_PROBE_ATTEMPTS раз через STANDBY_PROBE_INTERVAL_MS и становится шлюзом, только если ответа нет
+const uint32_t STANDBY_HEARTBEAT_MS = 100;
+const uint32_t STANDBY_TAKEOVER_MS = 400;
+const uint32_t STANDBY_PROBE_INTERVAL_MS = 50;
+const uint8_t STANDBY_PROBE_ATTEMPTS = 3;
+const uint32_t STANDBY_HELLO_INTERVAL_MS = 1000; // Резерв подтверждает шлюзу, что жив и синхронизирован
+const uint32_t STANDBY_LEASE_MS = 3000;          // Шлюз перестает слать пульс резерву, молчащему дольше
+
+const uint8_t PJON_RX_WAIT_TIME = 10; // ms, ожидание приема в блокирующем update()
+
+// Очередь отправки
+const uint32_t DEFAULT_TX_TIMEOUT_MS = 3000; // Максимальное время жизни сообщения в очереди
+const uint8_t TX_MAX_ATTEMPTS = 5;           // Попыток передачи до TX_STATUS_FAIL
+const uint32_t TX_BUSY_RETRY_MS = 5;         // Пауза при PJON_BUSY (попытка не засчитывается)
+const uint32_t MAX_BATCH_WINDOW_MS = 1000;
+
+// Групповая рассылка
+const uint8_t MULTICAST_FLAG_ACK_REQUESTED = 0x01;
+const uint8_t MULTICAST_HEADER_LEN = 5; // type, flags, seq, first_id, bitmap_len
+const uint32_t MULTICAST_ACK_SLOT_MS = 2;     // Окно случайной задержки MULTICAST_ACK на каждого адресата
+const uint32_t MULTICAST_ACK_MARGIN_MS = 200; // Запас шлюза сверх окна задержек до итога рассылки
+
+// Надежный поток
+const uint8_t DEFAULT_STREAM_WINDOW = 8;
+const uint8_t MAX_STREAM_WINDOW = 16;          // Не более половины окна SACK получателя (32 номера)
+const uint8_t STREAM_FLAG_ACK_REQUEST = 0x01; // Получатель должен ответить STREAM_ACK
+
+// Таймаут повтора (RTO) по измеренному RTT: srtt + 4 * rttvar (RFC 6298), растет линейно с номером попытки.
+// Применяется к ожиданию STREAM_ACK и FRAGMENT_STATUS.
+const uint32_t DEFAULT_RTO_MS = 50; // До первого измерения RTT
+const uint32_t MIN_RTO_MS = 10;     // Не меньше периода разбора приема в update()
+const uint32_t MAX_RTO_MS = 1000;
+
+// Фрагментация
+const uint8_t DEFAULT_FRAGMENT_WINDOW = 8;
+const uint8_t MAX_FRAGMENT_WINDOW = 32;
+const uint8_t FRAGMENT_FLAG_STATUS_REQUEST = 0x01;    // Получатель должен ответить FRAGMENT_STATUS
+const uint8_t FRAGMENT_MAX_STALLED_ROUNDS = 10;       // Окон подряд без продвижения до TX_STATUS_FAIL
+const uint32_t FRAGMENT_TIMEOUT_PER_FRAGMENT_MS = 50; // Добавка к setTxTimeout() на каждый фрагмент
+const uint32_t REASSEMBLY_TIMEOUT_MS = 5000;          // Неактивная сборка может быть вытеснена
+
+// Задача сети
+const uint32_t MESH_TASK_IDLE_WAIT_MS = 5; // Наибольшая пауза между циклами задачи (точность таймеров)
+const uint32_t MESH_TASK_MIN_STACK_SIZE = 4096;
 
 // --- Конструктор и Деструктор ---
 ROKOR_Mesh::ROKOR_Mesh() : _is_custom_pmk_set(false),
@@ -65,27 +135,84 @@ ROKOR_Mesh::ROKOR_Mesh() : _is_custom_pmk_set(false),
                            _forced_role_active(false),
                            _user_receive_cb(nullptr),
                            _user_receive_cb_custom_ptr(nullptr),
+                           _user_batch_receive_cb(nullptr),
+                           _user_batch_receive_cb_custom_ptr(nullptr),
                            _user_gateway_status_cb(nullptr),
                            _user_gateway_status_cb_custom_ptr(nullptr),
                            _user_node_status_cb(nullptr),
                            _user_node_status_cb_custom_ptr(nullptr),
+                           _user_tx_complete_cb(nullptr),
+                           _user_tx_complete_cb_custom_ptr(nullptr),
+                           _user_multicast_ack_cb(nullptr),
+                           _user_multicast_ack_cb_custom_ptr(nullptr),
                            _is_begun(false),
                            _fsm_state(DiscoveryFSM::INIT_STATE),
                            _fsm_timer_start(0),
                            _discovery_timeout_ms(DEFAULT_DISCOVERY_TIMEOUT_MS),
                            _gateway_contention_window_ms(DEFAULT_CONTENTION_WINDOW_MS),
+                           _gateway_priority(0),
+                           _standby_enabled(false),
                            _gateway_announce_interval_ms(DEFAULT_GATEWAY_ANNOUNCE_INTERVAL_MS),
                            _node_ping_gateway_interval_ms(DEFAULT_NODE_PING_INTERVAL_MS),
                            _node_max_gateway_ping_attempts(DEFAULT_NODE_MAX_PING_ATTEMPTS),
-                           _last_gateway_announce_time(0),
+                           _announce_trickle_interval_ms(ANNOUNCE_TRICKLE_MIN_INTERVAL_MS),
+                           _next_gateway_announce_time(0),
                            _current_gateway_connected_status(false),
                            _last_ack_from_gateway_time(0),
                            _next_gateway_ping_time(0),
                            _failed_gateway_pings_count(0),
+                           _rejoin_probing(false),
+                           _gw_beacon_period_ms(0),
+                           _last_gw_beacon_time(0),
+                           _gw_beacon_seq(0),
                            _known_nodes_count(0),
+                           _node_free_head(0),
                            _next_available_node_id_candidate(2),
-                           _last_node_cleanup_time(0),
-                           _contention_delay_value(0) // Инициализация новой переменной
+                           _node_inactivity_timeout_ms(0),
+                           _liveness_beacon_interval_ms(0),
+                           _last_liveness_beacon_time(0),
+                           _liveness_beacon_seq(0),
+                           _next_claim_time(0),
+                           _next_solicit_time(0),
+                           _next_node_id_request_time(0),
+                           _node_id_retry_window_ms(NODE_ID_RETRY_MIN_MS),
+                           _leases_dirty(false),
+                           _leases_first_change(0),
+                           _leases_last_change(0),
+                           _tx_head(0),
+                           _tx_tail(0),
+                           _tx_count(0),
+                           _tx_next_handle(1),
+                           _tx_timeout_ms(DEFAULT_TX_TIMEOUT_MS),
+                           _batching_enabled(false),
+                           _batch_window_ms(0),
+                           _stream_enabled(false),
+                           _stream_window(DEFAULT_STREAM_WINDOW),
+                           _multicast_seq(0),
+                           _multicast_ack_pending(false),
+                           _multicast_ack_seq(0),
+                           _multicast_ack_due(0),
+                           _fragment_window(DEFAULT_FRAGMENT_WINDOW),
+                           _fragment_next_msg_id(0),
+                           _rx_ring_head(0),
+                           _rx_ring_tail(0),
+                           _rx_overflow_count(0),
+                           _rx_unknown_frame_count(0),
+                           _rx_frame_time_us(0),
+                           _rx_batch_count(0),
+                           _rx_batch_used(0),
+                           _non_blocking_update(false),
+                           _activity_signal(nullptr),
+                           _activity_notify_task(nullptr),
+                           _mesh_task_enabled(false),
+                           _mesh_task_core(0),
+                           _mesh_task_priority(5),
+                           _mesh_task_stack_size(6144),
+                           _mesh_task_handle(nullptr),
+                           _mesh_task_running(false),
+                           _mesh_task_stop(false),
+                           _event_queue(nullptr),
+                           _event_overflow_count(0)
 {
     global_ROKOR_Mesh_instance = this;
     memset(_pjon_bus_id, 0, sizeof(_pjon_bus_id));
@@ -93,12 +220,32 @@ ROKOR_Mesh::ROKOR_Mesh() : _is_custom_pmk_set(false),
     memset(_esp_now_pmk, 0, sizeof(_esp_now_pmk));
     memset(_my_mac_addr, 0, sizeof(_my_mac_addr));
     memset(_gateway_mac_addr, 0, sizeof(_gateway_mac_addr));
+    portMUX_INITIALIZE(&_tx_queue_mux);
+    memset(_message_routes, 0, sizeof(_message_routes));
+    memset(_node_groups, 0, sizeof(_node_groups));
+    memset(_node_id_reserved, 0, sizeof(_node_id_reserved));
+    memset(_multicast_track, 0, sizeof(_multicast_track));
+    memset(&_peer_cache_stats, 0, sizeof(_peer_cache_stats));
+    resetPeerLink(_gateway_link);
+    initPeerCache();
     initNodeManagement();
+    initTxQueue();
+    initFragmentation();
 }
 
 ROKOR_Mesh::~ROKOR_Mesh()
 {
     end();
+    if (_activity_signal)
+    {
+        vSemaphoreDelete(_activity_signal);
+        _activity_signal = nullptr;
+    }
+    if (_event_queue)
+    {
+        vQueueDelete(_event_queue);
+        _event_queue = nullptr;
+    }
     global_ROKOR_Mesh_instance = nullptr;
 }
 
@@ -180,6 +327,11 @@ bool ROKOR_Mesh::begin(const char *networkName, uint8_t espNowChannel, uint8_t p
     Serial.printf(F("[ROKOR_Mesh] PJON Bus ID for network '%s': %d.%d.%d.%d\n"), _network_name_stored, _pjon_bus_id[0], _pjon_bus_id[1], _pjon_bus_id[2], _pjon_bus_id[3]);
 #endif
 
+    if (!_activity_signal)
+    {
+        _activity_signal = xSemaphoreCreateBinary();
+    }
+
     _is_begun = true;
     _fsm_state = DiscoveryFSM::INIT_STATE;
     _fsm_timer_start = millis();
@@ -207,6 +359,10 @@ bool ROKOR_Mesh::begin(const char *networkName, uint8_t espNowChannel, uint8_t p
         return false;
     }
 
+    if (_mesh_task_enabled)
+    {
+        startMeshTask();
+    }
     return true;
 }
 
@@ -219,8 +375,30 @@ void ROKOR_Mesh::end()
     Serial.println(F("[ROKOR_Mesh] Ending network activity..."));
 #endif
 
+    stopMeshTask();
+    flushRxBatch();
+    if (_current_role == ROLE_GATEWAY && _leases_dirty)
+    {
+        saveLeasesToNVS();
+    }
     _pjon_bus.end();
     espNowDeinit();
+    resetRxRing();
+
+    // Сообщения, оставшиеся в очереди, завершаются с ошибкой, чтобы каждый handle получил результат
+    for (uint8_t i = 0; i < ROKOR_MESH_TX_QUEUE_SIZE; ++i)
+    {
+        if (_tx_queue[i].state == TxSlotState::PENDING)
+        {
+            completeTxSlot(i, TX_STATUS_FAIL);
+        }
+    }
+    initTxQueue();
+    if (_fragment_tx.active)
+    {
+        completeFragmentTx(TX_STATUS_FAIL);
+    }
+    initFragmentation();
 
     _is_begun = false;
     _current_role = ROLE_UNINITIALIZED;
@@ -228,8 +406,11 @@ void ROKOR_Mesh::end()
     _myPjonId = PJON_NOT_ASSIGNED;
     _gatewayPjonId = PJON_NOT_ASSIGNED;
     _current_gateway_connected_status = false;
+    _rejoin_probing = false;
+    _gw_beacon_period_ms = 0;
     _is_custom_pmk_set = false;
     memset(_esp_now_pmk, 0, sizeof(_esp_now_pmk));
+    resetPeerLink(_gateway_link);
     initNodeManagement();
 #ifdef ROKOR_MESH_DEBUG_SERIAL
     Serial.println(F("[ROKOR_Mesh] Network activity ended."));
@@ -331,6 +512,20 @@ void ROKOR_Mesh::update()
     if (!_is_begun)
         return;
 
+    if (_mesh_task_running)
+    {
+        // Сеть обслуживает своя задача; здесь только callback-и приложения
+        dispatchEvents();
+    }
+    else
+    {
+        runMeshCycle();
+    }
+    flushRxBatch();
+}
+
+void ROKOR_Mesh::runMeshCycle()
+{
     runDiscoveryFSM();
 
     if (_current_role == ROLE_NODE)
@@ -341,137 +536,158 @@ void ROKOR_Mesh::update()
     {
         operateAsGateway();
     }
+    else if (_current_role == ROLE_STANDBY_GATEWAY)
+    {
+        operateAsStandby();
+    }
+
+    processTxQueue();
+    processFragmentTx();
+    processMulticastAcks();
 
     if (_pjon_bus.is_listening())
     {
+        drainRxRing();
         _pjon_bus.update();
-        _pjon_bus.receive(PJON_RX_WAIT_TIME);
+        // Блокирующий режим ждет прием на семафоре, а не опросом стратегии; задача сети ждет сама
+        if (!_non_blocking_update && !_mesh_task_running && waitForActivity(PJON_RX_WAIT_TIME))
+        {
+            drainRxRing();
+        }
     }
 }
 
-bool ROKOR_Mesh::sendMessage(uint8_t destinationId, const uint8_t *payload, uint16_t length)
+void ROKOR_Mesh::setNonBlockingUpdate(bool enabled) { _non_blocking_update = enabled; }
+void ROKOR_Mesh::setActivityNotifyTask(TaskHandle_t task) { _activity_notify_task = task; }
+
+bool ROKOR_Mesh::waitForActivity(uint32_t timeout_ms)
 {
-    if (!_is_begun || (_current_role != ROLE_NODE && _current_role != ROLE_GATEWAY))
-    {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] sendMessage: Network not active or role not operational."));
-#endif
-        return false;
-    }
-    if (destinationId == PJON_NOT_ASSIGNED || destinationId > 254)
-    {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] sendMessage: Invalid destination ID."));
-#endif
-        return false;
-    }
-    if (!payload || length == 0)
-    {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] sendMessage: Empty payload."));
-#endif
-        return false;
-    }
-    if (length > ROKOR_MESH_MAX_PAYLOAD_SIZE)
+    if (!_activity_signal)
     {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] sendMessage: Payload too long (%d > %d).\n"), length, ROKOR_MESH_MAX_PAYLOAD_SIZE);
-#endif
+        delay(timeout_ms);
         return false;
     }
+    // Кадры, пришедшие до вызова, уже отмечены семафором, поэтому сигнал не теряется
+    return xSemaphoreTake(_activity_signal, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
 
-    uint8_t target_mac[ESP_NOW_ETH_ALEN];
-    bool mac_found = false;
+bool ROKOR_Mesh::sendMessage(uint8_t destinationId, const uint8_t *payload, uint16_t length)
+{
+    return enqueueMessage(destinationId, ROKOR_MESH_DEFAULT_MESSAGE_TYPE, payload, length) != ROKOR_MESH_INVALID_TX_HANDLE;
+}
 
-    if (_current_role == ROLE_GATEWAY)
+bool ROKOR_Mesh::sendMessage(uint8_t destinationId, uint8_t messageType, const uint8_t *payload, uint16_t length)
+{
+    return enqueueMessage(destinationId, messageType, payload, length) != ROKOR_MESH_INVALID_TX_HANDLE;
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::enqueueMessage(uint8_t destinationId, const uint8_t *payload, uint16_t length)
+{
+    return enqueueMessage(destinationId, ROKOR_MESH_DEFAULT_MESSAGE_TYPE, payload, length);
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::enqueueMessage(uint8_t destinationId, uint8_t messageType, const uint8_t *payload, uint16_t length)
+{
+    if (payload && length > ROKOR_MESH_MAX_PAYLOAD_SIZE)
     {
-        if (destinationId == PJON_BROADCAST_ADDRESS)
-        {
-            memcpy(target_mac, _esp_now_broadcast_mac, ESP_NOW_ETH_ALEN);
-            mac_found = true;
-        }
-        else
-        {
-            int node_idx = findNodeById(destinationId);
-            if (node_idx != -1)
-            {
-                memcpy(target_mac, _known_nodes[node_idx].mac_addr, ESP_NOW_ETH_ALEN);
-                mac_found = true;
-            }
-            else
-            {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-                Serial.printf(F("[ROKOR_Mesh] sendMessage (GW): Destination node ID %d not found or MAC unknown.\n"), destinationId);
-#endif
-                return false;
-            }
-        }
+        return startFragmentedTx(destinationId, messageType, payload, length);
     }
-    else if (_current_role == ROLE_NODE)
+    if (!payload || !validateOutgoing(destinationId, length))
     {
-        if (destinationId == _gatewayPjonId)
-        {
-            if (memcmp(_gateway_mac_addr, _esp_now_null_mac, ESP_NOW_ETH_ALEN) != 0)
-            {
-                memcpy(target_mac, _gateway_mac_addr, ESP_NOW_ETH_ALEN);
-                mac_found = true;
-            }
-            else
-            {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-                Serial.println(F("[ROKOR_Mesh] sendMessage (Node): Gateway MAC unknown."));
-#endif
-                return false;
-            }
-        }
-        else
-        {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.printf(F("[ROKOR_Mesh] sendMessage (Node): Cannot send to ID %d. Nodes can only send to gateway.\n"), destinationId);
-#endif
-            return false;
-        }
+        return ROKOR_MESH_INVALID_TX_HANDLE;
     }
 
-    if (!mac_found)
+    if (_batching_enabled && length <= ROKOR_MESH_BATCH_MAX_ITEM_SIZE)
     {
-        return false;
+        return appendToBatch(destinationId, messageType, payload, length);
     }
 
-    _pjon_bus.strategy.set_receiver_mac(target_mac);
-    _pjon_bus.set_receiver_id(destinationId);
-
-    uint16_t response = _pjon_bus.send(payload, length);
+    int slot_idx = reserveTxSlot(destinationId);
+    if (slot_idx == -1)
+    {
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    TxSlot &slot = _tx_queue[slot_idx];
+    slot.data[0] = (uint8_t)MeshDiscoveryMessage::APP_MESSAGE;
+    slot.data[1] = messageType;
+    memcpy(&slot.data[APP_HEADER_LEN], payload, length);
+    ROKOR_Mesh_TxHandle handle = slot.handle;
+    commitTxSlot(slot_idx, APP_HEADER_LEN + length);
+    return handle;
+}
 
-    if (response == PJON_ACK)
+ROKOR_Mesh_TxBuffer ROKOR_Mesh::acquireTxBuffer(uint8_t destinationId, uint16_t maxLen, uint8_t messageType)
+{
+    ROKOR_Mesh_TxBuffer buffer = {ROKOR_MESH_INVALID_TX_HANDLE, nullptr, 0};
+    if (!validateOutgoing(destinationId, maxLen))
     {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] Message to ID %d sent successfully (ACK).\n"), destinationId);
-#endif
-        return true;
+        return buffer;
     }
-    else if (response == PJON_BUSY)
+    int slot_idx = reserveTxSlot(destinationId);
+    if (slot_idx != -1)
     {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] Message to ID %d failed: PJON_BUSY.\n"), destinationId);
-#endif
+        // Заголовок приложения пишется сразу, приложению отдается место под данные за ним
+        TxSlot &slot = _tx_queue[slot_idx];
+        slot.data[0] = (uint8_t)MeshDiscoveryMessage::APP_MESSAGE;
+        slot.data[1] = messageType;
+        buffer.handle = slot.handle;
+        buffer.data = &slot.data[APP_HEADER_LEN];
+        // Место перед данными занято запасом под заголовки DATA и приложения
+        buffer.capacity = sizeof(slot.frame) - DATA_HEADER_LEN - APP_HEADER_LEN;
     }
-    else if (response == PJON_FAIL)
+    return buffer;
+}
+
+bool ROKOR_Mesh::commitTx(ROKOR_Mesh_TxHandle handle, uint16_t length)
+{
+    int slot_idx = findTxSlot(handle);
+    if (slot_idx == -1 || _tx_queue[slot_idx].state != TxSlotState::RESERVED)
     {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] Message to ID %d failed: PJON_FAIL.\n"), destinationId);
+        Serial.printf(F("[ROKOR_Mesh] commitTx: Handle %d is not reserved.\n"), handle);
 #endif
+        return false;
     }
-    else
+    if (length == 0 || length > ROKOR_MESH_MAX_PAYLOAD_SIZE)
     {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] Message to ID %d queued (code: %d).\n"), destinationId, response);
+        Serial.printf(F("[ROKOR_Mesh] commitTx: Invalid length %d. Message dropped.\n"), length);
 #endif
-        return true;
+        abortTx(handle);
+        return false;
     }
-    return false;
+    commitTxSlot(slot_idx, APP_HEADER_LEN + length);
+    return true;
+}
+
+void ROKOR_Mesh::commitTxSlot(uint8_t slot_idx, uint16_t frame_length)
+{
+    uint32_t current_time = millis();
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    TxSlot &slot = _tx_queue[slot_idx];
+    slot.length = frame_length;
+    slot.enqueue_time = current_time;
+    slot.next_attempt_time = current_time;
+    slot.state = TxSlotState::PENDING;
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+    signalActivity();
+}
+
+void ROKOR_Mesh::abortTx(ROKOR_Mesh_TxHandle handle)
+{
+    int slot_idx = findTxSlot(handle);
+    if (slot_idx == -1 || _tx_queue[slot_idx].state != TxSlotState::RESERVED)
+        return;
+    // Слот освободится в processTxQueue(), когда до него дойдет начало кольца
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    _tx_queue[slot_idx].state = TxSlotState::DONE;
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
 }
 
+uint8_t ROKOR_Mesh::getTxQueueCount() const { return _tx_count; }
+uint32_t ROKOR_Mesh::getRxOverflowCount() const { return __atomic_load_n(&_rx_overflow_count, __ATOMIC_RELAXED); }
+uint32_t ROKOR_Mesh::getUnknownFrameCount() const { return __atomic_load_n(&_rx_unknown_frame_count, __ATOMIC_RELAXED); }
+
 bool ROKOR_Mesh::sendMessage(const uint8_t *payload, uint16_t length)
 {
     if (_current_role == ROLE_NODE)
@@ -503,6 +719,18 @@ void ROKOR_Mesh::setReceiveCallback(ROKOR_Mesh_ReceiveCallback callback, void *c
     _user_receive_cb = callback;
     _user_receive_cb_custom_ptr = custom_ptr;
 }
+
+void ROKOR_Mesh::setBatchReceiveCallback(ROKOR_Mesh_BatchReceiveCallback callback, void *custom_ptr)
+{
+    _user_batch_receive_cb = callback;
+    _user_batch_receive_cb_custom_ptr = custom_ptr;
+}
+
+void ROKOR_Mesh::onMessage(uint8_t messageType, ROKOR_Mesh_MessageHandler handler, void *custom_ptr)
+{
+    _message_routes[messageType].handler = handler;
+    _message_routes[messageType].custom_ptr = custom_ptr;
+}
 void ROKOR_Mesh::setGatewayStatusCallback(ROKOR_Mesh_GatewayStatusCallback callback, void *custom_ptr)
 {
     _user_gateway_status_cb = callback;
@@ -513,9 +741,20 @@ void ROKOR_Mesh::setNodeStatusCallback(ROKOR_Mesh_NodeStatusCallback callback, v
     _user_node_status_cb = callback;
     _user_node_status_cb_custom_ptr = custom_ptr;
 }
+void ROKOR_Mesh::setTxCompleteCallback(ROKOR_Mesh_TxCompleteCallback callback, void *custom_ptr)
+{
+    _user_tx_complete_cb = callback;
+    _user_tx_complete_cb_custom_ptr = custom_ptr;
+}
+void ROKOR_Mesh::setMulticastAckCallback(ROKOR_Mesh_MulticastAckCallback callback, void *custom_ptr)
+{
+    _user_multicast_ack_cb = callback;
+    _user_multicast_ack_cb_custom_ptr = custom_ptr;
+}
 
 ROKOR_Mesh_Role ROKOR_Mesh::getRole() const { return _current_role; }
 uint8_t ROKOR_Mesh::getPjonId() const { return _myPjonId; }
+uint8_t ROKOR_Mesh::getGatewayId() const { return _gatewayPjonId; }
 const uint8_t *ROKOR_Mesh::getBusId() const { return _pjon_bus_id; }
 const char *ROKOR_Mesh::getNetworkName() const { return _network_name_stored; }
 bool ROKOR_Mesh::isNetworkActive() const
@@ -529,9 +768,63 @@ bool ROKOR_Mesh::isGatewayConnected() const
 
 void ROKOR_Mesh::setDiscoveryTimeout(uint32_t timeout_ms) { _discovery_timeout_ms = timeout_ms; }
 void ROKOR_Mesh::setGatewayContentionWindow(uint32_t window_ms) { _gateway_contention_window_ms = std::max(100U, window_ms); }
+void ROKOR_Mesh::setGatewayPriority(uint8_t priority) { _gateway_priority = priority; }
 void ROKOR_Mesh::setGatewayAnnounceInterval(uint32_t interval_ms) { _gateway_announce_interval_ms = std::max(GATEWAY_MIN_ANNOUNCE_INTERVAL_MS, interval_ms); }
 void ROKOR_Mesh::setNodePingGatewayInterval(uint32_t interval_ms) { _node_ping_gateway_interval_ms = std::max(1000U, interval_ms); }
 void ROKOR_Mesh::setNodeMaxGatewayPingAttempts(uint8_t attempts) { _node_max_gateway_ping_attempts = std::max((uint8_t)1, attempts); }
+void ROKOR_Mesh::setNodeInactivityTimeout(uint32_t timeout_ms)
+{
+    _node_inactivity_timeout_ms = (timeout_ms == 0) ? 0 : std::max(LIVENESS_TICK_MS, timeout_ms);
+    // Сроки уже известных узлов пересчитываются, иначе сокращение срока сработало бы только через прежний
+    for (uint8_t i = 0; i < ROKOR_MESH_MAX_NODES; ++i)
+    {
+        if (_known_nodes[i].pjon_id != PJON_NOT_ASSIGNED)
+        {
+            unlinkLiveness(i);
+            scheduleLiveness(i);
+        }
+    }
+}
+void ROKOR_Mesh::setLivenessBeacon(uint32_t interval_ms)
+{
+    _liveness_beacon_interval_ms = (interval_ms == 0) ? 0 : std::min(LIVENESS_BEACON_MAX_INTERVAL_MS, std::max(LIVENESS_BEACON_MIN_INTERVAL_MS, interval_ms));
+}
+void ROKOR_Mesh::setTxTimeout(uint32_t timeout_ms) { _tx_timeout_ms = std::max(100U, timeout_ms); }
+void ROKOR_Mesh::setFragmentWindow(uint8_t fragments) { _fragment_window = std::min(MAX_FRAGMENT_WINDOW, std::max((uint8_t)1, fragments)); }
+void ROKOR_Mesh::setBatching(bool enabled, uint32_t window_ms)
+{
+    _batching_enabled = enabled;
+    _batch_window_ms = std::min(MAX_BATCH_WINDOW_MS, window_ms);
+}
+void ROKOR_Mesh::setReliableStream(bool enabled, uint8_t window)
+{
+    _stream_enabled = enabled;
+    _stream_window = std::min(MAX_STREAM_WINDOW, std::max((uint8_t)1, window));
+}
+
+bool ROKOR_Mesh::getLinkStats(uint8_t peerId, ROKOR_Mesh_LinkStats &stats) const
+{
+    const PeerLink *peer = nullptr;
+    if (_current_role == ROLE_NODE && peerId == _gatewayPjonId)
+    {
+        peer = &_gateway_link;
+    }
+    else if (_current_role == ROLE_GATEWAY)
+    {
+        int node_idx = findNodeById(peerId);
+        if (node_idx != -1)
+        {
+            peer = &_known_nodes[node_idx].link;
+        }
+    }
+    if (!peer)
+        return false;
+    stats.srtt_us = peer->srtt_us;
+    stats.rttvar_us = peer->rttvar_us;
+    stats.rto_ms = computeRtoMs(*peer);
+    stats.samples = peer->rtt_samples;
+    return true;
+}
 
 // --- Приватные методы ---
 void ROKOR_Mesh::initializePjonStack(uint8_t pjon_id, const uint8_t bus_id[4], bool is_gateway)
@@ -544,6 +837,9 @@ void ROKOR_Mesh::initializePjonStack(uint8_t pjon_id, const uint8_t bus_id[4], b
     _pjon_bus.set_bus_id(bus_id[0], bus_id[1], bus_id[2], bus_id[3]);
     _pjon_bus.set_receiver(_staticPjonReceiver);
     _pjon_bus.set_error(_staticPjonError);
+    // ACK PJON пришлось бы ждать внутри send_packet()/update(), поэтому он не используется: сообщения
+    // из очереди подтверждает STREAM_ACK, а служебные кадры при потере повторяются по своим таймаутам
+    _pjon_bus.set_acknowledge(false);
 
     _pjon_bus.strategy.set_channel(_espNowChannel);
 
@@ -551,13 +847,6 @@ void ROKOR_Mesh::initializePjonStack(uint8_t pjon_id, const uint8_t bus_id[4], b
     {
         addEspNowPeer(_esp_now_broadcast_mac, _espNowChannel, strlen(_esp_now_pmk) > 0);
     }
-    else
-    {
-        if (memcmp(_gateway_mac_addr, _esp_now_null_mac, ESP_NOW_ETH_ALEN) != 0)
-        {
-            addEspNowPeer(_gateway_mac_addr, _espNowChannel, strlen(_esp_now_pmk) > 0);
-        }
-    }
 
     _pjon_bus.begin();
     if (_pjon_bus.is_listening())
@@ -666,10 +955,10 @@ void ROKOR_Mesh::runDiscoveryFSM()
             {
                 if (_gatewayPjonId != PJON_NOT_ASSIGNED && memcmp(_gateway_mac_addr, _esp_now_null_mac, ESP_NOW_ETH_ALEN) != 0)
                 {
-                    addEspNowPeer(_gateway_mac_addr, _espNowChannel, strlen(_esp_now_pmk) > 0);
                     _current_gateway_connected_status = false;
                     _next_gateway_ping_time = current_time;
                     _failed_gateway_pings_count = 0;
+                    _rejoin_probing = true;
                 }
                 else
                 {
@@ -686,7 +975,8 @@ void ROKOR_Mesh::runDiscoveryFSM()
             else if (_current_role == ROLE_GATEWAY)
             {
                 initNodeManagement();
-                _last_gateway_announce_time = 0;
+                loadLeasesFromNVS();
+                startAnnounceTrickle();
             }
             _fsm_state = (_current_role == ROLE_NODE) ? DiscoveryFSM::OPERATIONAL_NODE : DiscoveryFSM::OPERATIONAL_GATEWAY;
 #ifdef ROKOR_MESH_DEBUG_SERIAL
@@ -727,7 +1017,7 @@ void ROKOR_Mesh::runDiscoveryFSM()
                     break;
                 }
                 initNodeManagement();
-                _last_gateway_announce_time = 0;
+                startAnnounceTrickle();
                 saveConfigToNVS();
                 _fsm_state = DiscoveryFSM::OPERATIONAL_GATEWAY;
 #ifdef ROKOR_MESH_DEBUG_SERIAL
@@ -797,14 +1087,20 @@ void ROKOR_Mesh::runDiscoveryFSM()
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         Serial.println(F("[FSM] State: LISTEN_FOR_GATEWAY"));
 #endif
+        // Запрос при входе в состояние (если предыдущий был давно) и затем с интервалом, чтобы не ждать периодического объявления
+        if ((int32_t)(current_time - _next_solicit_time) >= 0)
+        {
+            sendGatewaySolicit();
+        }
         if (current_time - _fsm_timer_start > _discovery_timeout_ms)
         {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.println(F("[FSM] LISTEN_FOR_GATEWAY: Timeout. No gateway found. -> GATEWAY_ELECTION_DELAY"));
 #endif
+            // Прием не останавливается: на выборах кандидаты слышат заявки друг друга
             _fsm_state = DiscoveryFSM::GATEWAY_ELECTION_DELAY;
             _fsm_timer_start = current_time;
-            _pjon_bus.end();
+            _next_claim_time = current_time + esp_random() % ELECTION_CLAIM_JITTER_MS;
         }
         break;
 
@@ -812,21 +1108,19 @@ void ROKOR_Mesh::runDiscoveryFSM()
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         Serial.println(F("[FSM] State: GATEWAY_ELECTION_DELAY"));
 #endif
-        if (_contention_delay_value == 0)
+        // Кандидат, услышавший заявку старшего, выходит из выборов при приеме (actualPjonReceiver).
+        // Остальные побеждают по окончании окна, поэтому выборы длятся одно окно независимо от числа кандидатов.
+        if ((int32_t)(current_time - _next_claim_time) >= 0)
         {
-            _contention_delay_value = esp_random() % _gateway_contention_window_ms;
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.printf(F("[FSM] Gateway contention delay: %d ms\n"), _contention_delay_value);
-#endif
+            sendGatewayClaim();
         }
-        if (current_time - _fsm_timer_start > _contention_delay_value)
+        if (current_time - _fsm_timer_start > _gateway_contention_window_ms)
         {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.println(F("[FSM] GATEWAY_ELECTION_DELAY: Contention delay passed. -> ANNOUNCE_AS_GATEWAY"));
+            Serial.println(F("[FSM] GATEWAY_ELECTION_DELAY: No higher-ranked claim heard. -> ANNOUNCE_AS_GATEWAY"));
 #endif
             _fsm_state = DiscoveryFSM::ANNOUNCE_AS_GATEWAY;
             _fsm_timer_start = current_time;
-            _contention_delay_value = 0;
         }
         break;
 
@@ -845,8 +1139,7 @@ void ROKOR_Mesh::runDiscoveryFSM()
         }
 
         initNodeManagement();
-        sendGatewayAnnounce();
-        _last_gateway_announce_time = current_time;
+        startAnnounceTrickle();
 
         saveConfigToNVS();
         _fsm_state = DiscoveryFSM::OPERATIONAL_GATEWAY;
@@ -867,6 +1160,10 @@ void ROKOR_Mesh::runDiscoveryFSM()
             _fsm_state = DiscoveryFSM::LISTEN_FOR_GATEWAY;
             _fsm_timer_start = current_time;
         }
+        else if ((int32_t)(current_time - _next_node_id_request_time) >= 0)
+        {
+            sendNodeIdRequest(); // Запрос или ответ потерян (например, шлюз занят запросами других узлов)
+        }
         break;
 
     case DiscoveryFSM::OPERATIONAL_NODE:
@@ -881,6 +1178,9 @@ void ROKOR_Mesh::runDiscoveryFSM()
 #endif
         break;
 
+    case DiscoveryFSM::STANDBY_GATEWAY:
+        break; // Работу резерва ведет operateAsStandby()
+
     case DiscoveryFSM::ERROR_STATE:
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         Serial.println(F("[FSM] State: ERROR_STATE. Halting FSM."));
@@ -972,7 +1272,7 @@ bool ROKOR_Mesh::loadConfigFromNVS()
 
 void ROKOR_Mesh::saveConfigToNVS()
 {
-    if (_current_role == ROLE_UNINITIALIZED || _current_role == ROLE_DISCOVERING || _current_role == ROLE_ERROR)
+    if (_current_role == ROLE_UNINITIALIZED || _current_role == ROLE_DISCOVERING || _current_role == ROLE_STANDBY_GATEWAY || _current_role == ROLE_ERROR)
     {
         return;
     }
@@ -1029,6 +1329,7 @@ void ROKOR_Mesh::clearConfigNVS()
         nvs_erase_key(nvs_handle, NVS_KEY_CHANNEL);
         nvs_erase_key(nvs_handle, NVS_KEY_GW_ID);
         nvs_erase_key(nvs_handle, NVS_KEY_GW_MAC);
+        nvs_erase_key(nvs_handle, NVS_KEY_LEASES);
         err = nvs_commit(nvs_handle);
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         if (err == ESP_OK)
@@ -1050,88 +1351,271 @@ void ROKOR_Mesh::clearConfigNVS()
     }
 }
 
-// ESP-NOW статические callback-функции
-void ROKOR_Mesh::_esp_now_on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status)
+void ROKOR_Mesh::markLeasesDirty()
 {
-    if (global_ROKOR_Mesh_instance)
+    uint32_t current_time = millis();
+    if (!_leases_dirty)
     {
-        global_ROKOR_Mesh_instance->_pjon_bus.strategy.esp_now_send_callback(mac_addr, status);
+        _leases_dirty = true;
+        _leases_first_change = current_time;
     }
+    _leases_last_change = current_time;
 }
 
-void ROKOR_Mesh::_esp_now_on_data_recv(const esp_now_recv_info_t *recv_info, const uint8_t *incoming_data, int len)
+void ROKOR_Mesh::saveLeasesIfDue()
 {
-    if (global_ROKOR_Mesh_instance && recv_info && incoming_data && len > 0)
+    if (!_leases_dirty)
+        return;
+    // Запись откладывается до паузы в изменениях, чтобы волна подключений дала одну запись во flash
+    uint32_t current_time = millis();
+    if (current_time - _leases_last_change >= LEASE_SAVE_QUIET_MS || current_time - _leases_first_change >= LEASE_SAVE_MAX_DELAY_MS)
     {
-        global_ROKOR_Mesh_instance->_pjon_bus.strategy.esp_now_receive_callback(recv_info->src_addr, incoming_data, len);
+        saveLeasesToNVS();
     }
 }
 
-bool ROKOR_Mesh::espNowInit()
+void ROKOR_Mesh::saveLeasesToNVS()
 {
-    esp_err_t channel_err = esp_wifi_set_channel(_espNowChannel, WIFI_SECOND_CHAN_NONE);
-    if (channel_err != ESP_OK)
+    _leases_dirty = false;
+    uint8_t records[LEASE_HEADER_LEN + ROKOR_MESH_MAX_NODES * LEASE_RECORD_LEN];
+    size_t len = LEASE_HEADER_LEN;
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < ROKOR_MESH_MAX_NODES; ++i)
     {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.printf(F("[ROKOR_Mesh] Failed to set ESP-NOW channel %d: %s\n"), _espNowChannel, esp_err_to_name(channel_err));
-#endif
-        return false;
+        if (_known_nodes[i].pjon_id == PJON_NOT_ASSIGNED)
+            continue;
+        records[len] = _known_nodes[i].pjon_id;
+        memcpy(&records[len + 1], _known_nodes[i].mac_addr, ESP_NOW_ETH_ALEN);
+        len += LEASE_RECORD_LEN;
+        count++;
     }
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.printf(F("[ROKOR_Mesh] ESP-NOW channel set to: %d\n"), _espNowChannel);
-#endif
+    records[0] = LEASE_BLOB_VERSION;
+    records[1] = count;
 
-    if (esp_now_init() != ESP_OK)
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK)
     {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] Error initializing ESP-NOW"));
+        Serial.printf(F("[NVS] Failed to open NVS for leases: %s\n"), esp_err_to_name(err));
 #endif
-        return false;
+        return;
     }
-
-    if (strlen(_esp_now_pmk) > 0)
+    err = (count > 0) ? nvs_set_blob(nvs_handle, NVS_KEY_LEASES, records, len) : nvs_erase_key(nvs_handle, NVS_KEY_LEASES);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND)
     {
-        if (esp_now_set_pmk((const uint8_t *)_esp_now_pmk) != ESP_OK)
-        {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.println(F("[ROKOR_Mesh] Error setting ESP-NOW PMK. Encryption might fail."));
-#endif
-        }
-        else
-        {
+        err = nvs_commit(nvs_handle);
+    }
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.println(F("[ROKOR_Mesh] ESP-NOW PMK set. Link will be encrypted if peer also has PMK."));
-#endif
-        }
+    if (err == ESP_OK)
+    {
+        Serial.printf(F("[NVS] Saved %u node leases.\n"), count);
     }
     else
     {
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] No PMK set for ESP-NOW. Link will be unencrypted."));
-#endif
+        Serial.printf(F("[NVS] Failed to save node leases: %s\n"), esp_err_to_name(err));
     }
+#endif
+    nvs_close(nvs_handle);
+}
 
-    if (esp_now_register_send_cb(_esp_now_on_data_sent) != ESP_OK)
+void ROKOR_Mesh::loadLeasesFromNVS()
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK)
+        return;
+    // Размер записи зависит от ROKOR_MESH_MAX_NODES прошивки, которая ее сохранила: читаем целиком в кучу
+    size_t len = 0;
+    esp_err_t err = nvs_get_blob(nvs_handle, NVS_KEY_LEASES, nullptr, &len);
+    uint8_t *records = (err == ESP_OK && len > 0) ? (uint8_t *)malloc(len) : nullptr;
+    if (records)
+    {
+        err = nvs_get_blob(nvs_handle, NVS_KEY_LEASES, records, &len);
+    }
+    nvs_close(nvs_handle);
+    if (!records || err != ESP_OK)
     {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] Error registering ESP-NOW send callback"));
+        Serial.printf(F("[NVS] No node leases loaded: %s\n"), esp_err_to_name(err == ESP_OK ? ESP_ERR_NO_MEM : err));
 #endif
-        esp_now_deinit();
-        return false;
+        free(records);
+        return;
     }
-    if (esp_now_register_recv_cb(_esp_now_on_data_recv) != ESP_OK)
+
+    // Запись неизвестной версии или с числом записей больше длины не трогаем
+    if (len < LEASE_HEADER_LEN || records[0] != LEASE_BLOB_VERSION || LEASE_HEADER_LEN + (size_t)records[1] * LEASE_RECORD_LEN > len)
     {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-        Serial.println(F("[ROKOR_Mesh] Error registering ESP-NOW receive callback"));
+        Serial.printf(F("[NVS] Node leases have unknown format (version %d, %u bytes). Ignoring.\n"), records[0], (unsigned)len);
 #endif
-        esp_now_unregister_send_cb();
-        esp_now_deinit();
-        return false;
+        free(records);
+        return;
+    }
+
+    size_t pos = LEASE_HEADER_LEN;
+    size_t stored = records[1];
+    bool rewrite = false;
+    uint8_t restored = 0;
+    for (size_t i = 0; i < stored; ++i, pos += LEASE_RECORD_LEN)
+    {
+        uint8_t node_id = records[pos];
+        const uint8_t *mac = &records[pos + 1];
+        if (node_id == PJON_BROADCAST_ADDRESS || node_id == PJON_NOT_ASSIGNED || node_id == _myPjonId ||
+            findNodeById(node_id) != -1 || findNodeByMac(mac) != -1)
+            continue;
+        if (addNode(node_id, mac) == -1)
+        {
+            // Таблица сохранена с большим ROKOR_MESH_MAX_NODES: остальные записи отбрасываются
+            rewrite = true;
+            break;
+        }
+        restored++;
     }
+    free(records);
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.println(F("[ROKOR_Mesh] ESP-NOW initialized successfully."));
+    Serial.printf(F("[NVS] Restored %u of %u node leases.\n"), restored, (unsigned)stored);
 #endif
-    return true;
+    // Восстановленная таблица совпадает с сохраненной; усеченная таблица перезаписывается
+    _leases_dirty = false;
+    if (rewrite)
+    {
+        markLeasesDirty();
+    }
+}
+
+// ESP-NOW статические callback-функции
+void ROKOR_Mesh::_esp_now_on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status)
+{
+    if (global_ROKOR_Mesh_instance)
+    {
+        global_ROKOR_Mesh_instance->_pjon_bus.strategy.esp_now_send_callback(mac_addr, status);
+    }
+}
+
+void ROKOR_Mesh::_esp_now_on_data_recv(const esp_now_recv_info_t *recv_info, const uint8_t *incoming_data, int len)
+{
+    ROKOR_Mesh *self = global_ROKOR_Mesh_instance;
+    if (!self || !recv_info || !incoming_data || len <= 0 || len > ESP_NOW_MAX_DATA_LEN)
+        return;
+
+    // Задача WiFi только копирует кадр в кольцо; стратегию PJON и разбор кадра трогает только update()
+    uint16_t head = __atomic_load_n(&self->_rx_ring_head, __ATOMIC_RELAXED);
+    uint16_t next = (head + 1) % ROKOR_MESH_RX_RING_SIZE;
+    if (next == __atomic_load_n(&self->_rx_ring_tail, __ATOMIC_ACQUIRE))
+    {
+        __atomic_fetch_add(&self->_rx_overflow_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    RxFrame &frame = self->_rx_ring[head];
+    memcpy(frame.src_mac, recv_info->src_addr, ESP_NOW_ETH_ALEN);
+    frame.length = (uint8_t)len;
+    frame.rx_time_us = micros();
+    memcpy(frame.data, incoming_data, len);
+    __atomic_store_n(&self->_rx_ring_head, next, __ATOMIC_RELEASE);
+    self->signalActivity();
+}
+
+void ROKOR_Mesh::signalActivity()
+{
+    if (_activity_signal)
+    {
+        xSemaphoreGive(_activity_signal);
+    }
+    TaskHandle_t task = _activity_notify_task;
+    if (task)
+    {
+        xTaskNotifyGive(task);
+    }
+}
+
+void ROKOR_Mesh::resetRxRing()
+{
+    // Вызывается, когда callback ESP-NOW не зарегистрирован
+    _rx_ring_head = 0;
+    _rx_ring_tail = 0;
+}
+
+void ROKOR_Mesh::drainRxRing()
+{
+    // Разбираются кадры, уже лежащие в кольце; пришедшие во время разбора ждут следующего update()
+    uint16_t tail = _rx_ring_tail;
+    uint16_t head = __atomic_load_n(&_rx_ring_head, __ATOMIC_ACQUIRE);
+    while (tail != head)
+    {
+        RxFrame &frame = _rx_ring[tail];
+        _rx_frame_time_us = frame.rx_time_us;
+        _pjon_bus.strategy.esp_now_receive_callback(frame.src_mac, frame.data, frame.length);
+        _pjon_bus.receive();
+        tail = (tail + 1) % ROKOR_MESH_RX_RING_SIZE;
+        __atomic_store_n(&_rx_ring_tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+bool ROKOR_Mesh::espNowInit()
+{
+    esp_err_t channel_err = esp_wifi_set_channel(_espNowChannel, WIFI_SECOND_CHAN_NONE);
+    if (channel_err != ESP_OK)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] Failed to set ESP-NOW channel %d: %s\n"), _espNowChannel, esp_err_to_name(channel_err));
+#endif
+        return false;
+    }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[ROKOR_Mesh] ESP-NOW channel set to: %d\n"), _espNowChannel);
+#endif
+
+    if (esp_now_init() != ESP_OK)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Error initializing ESP-NOW"));
+#endif
+        return false;
+    }
+
+    if (strlen(_esp_now_pmk) > 0)
+    {
+        if (esp_now_set_pmk((const uint8_t *)_esp_now_pmk) != ESP_OK)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.println(F("[ROKOR_Mesh] Error setting ESP-NOW PMK. Encryption might fail."));
+#endif
+        }
+        else
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.println(F("[ROKOR_Mesh] ESP-NOW PMK set. Link will be encrypted if peer also has PMK."));
+#endif
+        }
+    }
+    else
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] No PMK set for ESP-NOW. Link will be unencrypted."));
+#endif
+    }
+
+    if (esp_now_register_send_cb(_esp_now_on_data_sent) != ESP_OK)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Error registering ESP-NOW send callback"));
+#endif
+        esp_now_deinit();
+        return false;
+    }
+    if (esp_now_register_recv_cb(_esp_now_on_data_recv) != ESP_OK)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Error registering ESP-NOW receive callback"));
+#endif
+        esp_now_unregister_send_cb();
+        esp_now_deinit();
+        return false;
+    }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.println(F("[ROKOR_Mesh] ESP-NOW initialized successfully."));
+#endif
+    return true;
 }
 
 void ROKOR_Mesh::espNowDeinit()
@@ -1139,15 +1623,16 @@ void ROKOR_Mesh::espNowDeinit()
     esp_now_unregister_recv_cb();
     esp_now_unregister_send_cb();
     esp_now_deinit();
+    initPeerCache(); // esp_now_deinit() удаляет всех пиров
 #ifdef ROKOR_MESH_DEBUG_SERIAL
     Serial.println(F("[ROKOR_Mesh] ESP-NOW de-initialized."));
 #endif
 }
 
-void ROKOR_Mesh::addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool encrypt_link)
+esp_err_t ROKOR_Mesh::addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool encrypt_link)
 {
     if (!mac_address)
-        return;
+        return ESP_ERR_INVALID_ARG;
 #ifdef ROKOR_MESH_DEBUG_SERIAL
     Serial.printf("[ROKOR_Mesh] Adding/Modifying ESP-NOW peer: %02X:%02X:%02X:%02X:%02X:%02X on channel %d, encrypt: %d\n",
                   mac_address[0], mac_address[1], mac_address[2], mac_address[3], mac_address[4], mac_address[5], channel, encrypt_link);
@@ -1179,13 +1664,12 @@ void ROKOR_Mesh::addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool
                 Serial.println(F("[ROKOR_Mesh] ESP-NOW peer added (after del/mod fail)."));
             }
 #endif
+            return add_err;
         }
-        else
-        {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-            Serial.println(F("[ROKOR_Mesh] ESP-NOW peer modified."));
+        Serial.println(F("[ROKOR_Mesh] ESP-NOW peer modified."));
 #endif
-        }
+        return ESP_OK;
     }
     else
     {
@@ -1200,9 +1684,133 @@ void ROKOR_Mesh::addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool
             Serial.println(F("[ROKOR_Mesh] ESP-NOW peer added."));
         }
 #endif
+        return add_err;
+    }
+}
+
+// --- Кэш пиров ESP-NOW ---
+void ROKOR_Mesh::initPeerCache()
+{
+    memset(_peer_cache, 0, sizeof(_peer_cache));
+    _peer_cache_clock = 0;
+}
+
+uint8_t ROKOR_Mesh::peerCacheCapacity() const
+{
+    // Зашифрованных пиров ESP-NOW допускает меньше, чем всего
+    if (strlen(_esp_now_pmk) > 0 && ESP_NOW_MAX_ENCRYPT_PEER_NUM < ROKOR_MESH_PEER_CACHE_SIZE)
+        return ESP_NOW_MAX_ENCRYPT_PEER_NUM;
+    return ROKOR_MESH_PEER_CACHE_SIZE;
+}
+
+int ROKOR_Mesh::evictLruPeer()
+{
+    int lru = -1;
+    for (uint8_t i = 0; i < ROKOR_MESH_PEER_CACHE_SIZE; ++i)
+    {
+        if (_peer_cache[i].used && (lru == -1 || (int32_t)(_peer_cache[i].last_use - _peer_cache[lru].last_use) < 0))
+        {
+            lru = i;
+        }
+    }
+    if (lru == -1)
+        return -1;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[ROKOR_Mesh] Evicting ESP-NOW peer %02X:%02X:%02X:%02X:%02X:%02X\n"),
+                  _peer_cache[lru].mac[0], _peer_cache[lru].mac[1], _peer_cache[lru].mac[2],
+                  _peer_cache[lru].mac[3], _peer_cache[lru].mac[4], _peer_cache[lru].mac[5]);
+#endif
+    esp_now_del_peer(_peer_cache[lru].mac);
+    _peer_cache[lru].used = false;
+    _peer_cache_stats.evictions++;
+    return lru;
+}
+
+bool ROKOR_Mesh::ensurePeer(const uint8_t mac[6])
+{
+    uint8_t capacity = peerCacheCapacity();
+    int free_idx = -1;
+    for (uint8_t i = 0; i < ROKOR_MESH_PEER_CACHE_SIZE; ++i)
+    {
+        PeerCacheEntry &entry = _peer_cache[i];
+        if (!entry.used)
+        {
+            if (free_idx == -1 && i < capacity)
+                free_idx = i;
+            continue;
+        }
+        if (memcmp(entry.mac, mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+            entry.last_use = ++_peer_cache_clock;
+            _peer_cache_stats.hits++;
+            return true;
+        }
+    }
+
+    _peer_cache_stats.misses++;
+    if (free_idx == -1)
+    {
+        free_idx = evictLruPeer();
+    }
+    esp_err_t err;
+    while ((err = addEspNowPeer(mac, _espNowChannel, strlen(_esp_now_pmk) > 0)) == ESP_ERR_ESPNOW_FULL)
+    {
+        // Часть аппаратной таблицы занята пирами вне кэша: освобождаем еще одно место
+        if (evictLruPeer() == -1)
+            break;
+    }
+    if (err != ESP_OK || free_idx == -1)
+        return false;
+
+    PeerCacheEntry &entry = _peer_cache[free_idx];
+    memcpy(entry.mac, mac, ESP_NOW_ETH_ALEN);
+    entry.last_use = ++_peer_cache_clock;
+    entry.used = true;
+    return true;
+}
+
+void ROKOR_Mesh::selectPeer(const uint8_t mac[6])
+{
+    if (memcmp(mac, _esp_now_broadcast_mac, ESP_NOW_ETH_ALEN) == 0)
+    {
+        // Широковещательный пир не вытесняется и в кэш не входит
+        if (!esp_now_is_peer_exist(mac))
+            addEspNowPeer(mac, _espNowChannel, strlen(_esp_now_pmk) > 0);
+    }
+    else
+    {
+        ensurePeer(mac);
+    }
+    _pjon_bus.strategy.set_receiver_mac(mac);
+}
+
+void ROKOR_Mesh::releasePeer(const uint8_t mac[6])
+{
+    for (uint8_t i = 0; i < ROKOR_MESH_PEER_CACHE_SIZE; ++i)
+    {
+        if (_peer_cache[i].used && memcmp(_peer_cache[i].mac, mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+            esp_now_del_peer(mac);
+            _peer_cache[i].used = false;
+            return;
+        }
+    }
+}
+
+void ROKOR_Mesh::getPeerCacheStats(ROKOR_Mesh_PeerCacheStats &stats) const
+{
+    stats = _peer_cache_stats;
+    stats.peers = 0;
+    for (uint8_t i = 0; i < ROKOR_MESH_PEER_CACHE_SIZE; ++i)
+    {
+        if (_peer_cache[i].used)
+            stats.peers++;
     }
+    stats.capacity = peerCacheCapacity();
 }
 
+void ROKOR_Mesh::resetPeerCacheStats() { memset(&_peer_cache_stats, 0, sizeof(_peer_cache_stats)); }
+
 // --- Статические callback-функции PJON ---
 void ROKOR_Mesh::_staticPjonReceiver(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info)
 {
@@ -1237,22 +1845,46 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
                   length, payload[0]);
 #endif
 
+    // [MAC][приоритет][версия]: шлюз и кандидаты другой версии протокола не участвуют ни в подключении, ни в выборах
+    if ((msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE || msg_type == MeshDiscoveryMessage::GATEWAY_CLAIM) &&
+        (actual_length < ESP_NOW_ETH_ALEN + 2 || actual_payload[ESP_NOW_ETH_ALEN + 1] != ROKOR_MESH_PROTOCOL_VERSION))
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[PJON RX] Gateway frame from ID %d has another protocol version. Ignoring.\n"), packet_info.sender_id);
+#endif
+        return;
+    }
+
     if (_fsm_state == DiscoveryFSM::LISTEN_FOR_GATEWAY || _fsm_state == DiscoveryFSM::GATEWAY_ELECTION_DELAY ||
         (_fsm_state == DiscoveryFSM::CHECK_FORCED_ROLE && _current_role == ROLE_NODE && (_myPjonId == PJON_NOT_ASSIGNED || _myPjonId == 0)))
     {
+        if (msg_type == MeshDiscoveryMessage::GATEWAY_CLAIM && actual_length >= ESP_NOW_ETH_ALEN + 1)
+        {
+            if (_fsm_state == DiscoveryFSM::GATEWAY_ELECTION_DELAY && outranksMe(actual_payload[ESP_NOW_ETH_ALEN], actual_payload))
+            {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+                Serial.println(F("[FSM RX] Higher-ranked GATEWAY_CLAIM. -> LISTEN_FOR_GATEWAY"));
+#endif
+                // Победитель станет шлюзом по окончании своего окна и ответит на GATEWAY_SOLICIT
+                _fsm_state = DiscoveryFSM::LISTEN_FOR_GATEWAY;
+                _fsm_timer_start = millis();
+            }
+            return;
+        }
         if (msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE && actual_length >= ESP_NOW_ETH_ALEN)
         {
             _gatewayPjonId = packet_info.sender_id;
             memcpy(_gateway_mac_addr, actual_payload, ESP_NOW_ETH_ALEN);
-
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.printf(F("[FSM RX] GATEWAY_ANNOUNCE from ID %d, MAC: %02X:%02X:%02X:%02X:%02X:%02X\n"),
                           _gatewayPjonId, _gateway_mac_addr[0], _gateway_mac_addr[1], _gateway_mac_addr[2], _gateway_mac_addr[3], _gateway_mac_addr[4], _gateway_mac_addr[5]);
 #endif
 
-            addEspNowPeer(_gateway_mac_addr, _espNowChannel, strlen(_esp_now_pmk) > 0);
-
-            if (_current_role == ROLE_DISCOVERING || (_forced_role_active && _current_role == ROLE_NODE))
+            if (_standby_enabled && _current_role == ROLE_DISCOVERING)
+            {
+                enterStandby();
+            }
+            else if (_current_role == ROLE_DISCOVERING || (_forced_role_active && _current_role == ROLE_NODE))
             {
                 if (_myPjonId == PJON_NOT_ASSIGNED || _myPjonId == 0)
                 {
@@ -1261,6 +1893,7 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
 #endif
                     _fsm_state = DiscoveryFSM::REQUEST_NODE_ID;
                     _fsm_timer_start = millis();
+                    _node_id_retry_window_ms = NODE_ID_RETRY_MIN_MS;
                     sendNodeIdRequest();
                 }
                 else
@@ -1274,14 +1907,40 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
                     _current_gateway_connected_status = false;
                     _next_gateway_ping_time = millis();
                     _failed_gateway_pings_count = 0;
+                    _rejoin_probing = true;
                 }
             }
             return;
         }
     }
 
+    if (_current_role == ROLE_STANDBY_GATEWAY)
+    {
+        if (msg_type == MeshDiscoveryMessage::GATEWAY_SYNC && packet_info.sender_id == _gatewayPjonId)
+        {
+            handleGatewaySync(actual_payload, actual_length);
+        }
+        else if (msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE && actual_length >= ESP_NOW_ETH_ALEN &&
+                 (packet_info.sender_id != _gatewayPjonId || memcmp(actual_payload, _gateway_mac_addr, ESP_NOW_ETH_ALEN) != 0))
+        {
+            // В сети другой шлюз (например, после выборов): резерв переходит к нему
+            releasePeer(_gateway_mac_addr);
+            _gatewayPjonId = packet_info.sender_id;
+            memcpy(_gateway_mac_addr, actual_payload, ESP_NOW_ETH_ALEN);
+            enterStandby();
+        }
+        return;
+    }
+
     if (_current_role == ROLE_GATEWAY)
     {
+        // Любой кадр от известного узла продлевает его срок; колесо проверит новый срок при срабатывании корзины
+        int sender_idx = findNodeById(packet_info.sender_id);
+        if (sender_idx != -1)
+        {
+            _known_nodes[sender_idx].last_seen = millis();
+        }
+
         if (msg_type == MeshDiscoveryMessage::NODE_ID_REQUEST && actual_length >= ESP_NOW_ETH_ALEN)
         {
             const uint8_t *node_mac = actual_payload;
@@ -1291,32 +1950,82 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
 #endif
             handleNodeIdRequest(packet_info, node_mac);
         }
+        else if ((msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE || msg_type == MeshDiscoveryMessage::GATEWAY_CLAIM) &&
+                 actual_length >= ESP_NOW_ETH_ALEN && memcmp(actual_payload, _my_mac_addr, ESP_NOW_ETH_ALEN) != 0)
+        {
+            // Второй шлюз в сети (одновременные выборы или слияние сетей): уступает младший.
+            // Заявке кандидата работающий шлюз не уступает, а отвечает объявлением.
+            uint8_t their_priority = (actual_length > ESP_NOW_ETH_ALEN) ? actual_payload[ESP_NOW_ETH_ALEN] : 0;
+            if (msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE && !_forced_role_active && outranksMe(their_priority, actual_payload))
+            {
+                stepDownToNode(packet_info.sender_id, actual_payload);
+                return;
+            }
+            resetAnnounceTrickle();
+        }
+        else if (msg_type == MeshDiscoveryMessage::STANDBY_HELLO)
+        {
+            handleStandbyHello(actual_payload, actual_length);
+        }
+        else if (msg_type == MeshDiscoveryMessage::GATEWAY_SYNC)
+        {
+            // Прежний шлюз ожил и считает нас резервом: два шлюза видят друг друга. Объявление на его MAC
+            // запускает у него то же правило, что и выше (приоритет, затем MAC), и младший уступает.
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[GW RX] GATEWAY_SYNC from another gateway (ID %d). Announcing to it.\n"), packet_info.sender_id);
+#endif
+            sendGatewayAnnounce(packet_info.sender_ethernet_address);
+            resetAnnounceTrickle();
+        }
+        else if (msg_type == MeshDiscoveryMessage::GATEWAY_SOLICIT && actual_length >= ESP_NOW_ETH_ALEN)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[GW RX] GATEWAY_SOLICIT from MAC: %02X:%02X:%02X:%02X:%02X:%02X\n"),
+                          actual_payload[0], actual_payload[1], actual_payload[2], actual_payload[3], actual_payload[4], actual_payload[5]);
+#endif
+            queueSolicitReply(actual_payload);
+            resetAnnounceTrickle(); // Узел ищет шлюз - возможно, искать начали и другие
+        }
         else if (msg_type == MeshDiscoveryMessage::NODE_ID_ACK)
         {
             int node_idx = findNodeById(packet_info.sender_id);
             if (node_idx != -1)
             {
                 _known_nodes[node_idx].id_assigned_this_session = false;
-                _known_nodes[node_idx].last_seen = millis();
                 updateNodeStatus(packet_info.sender_id, true, "ID_ACK");
 #ifdef ROKOR_MESH_DEBUG_SERIAL
                 Serial.printf(F("[GW RX] NODE_ID_ACK from Node ID %d.\n"), packet_info.sender_id);
 #endif
             }
         }
+        else if (msg_type == MeshDiscoveryMessage::MULTICAST_ACK && actual_length >= 1)
+        {
+            handleMulticastAck(packet_info.sender_id, actual_payload[0]);
+        }
+        else if (msg_type == MeshDiscoveryMessage::FRAGMENT)
+        {
+            handleFragment(packet_info.sender_id, payload, length);
+        }
+        else if (msg_type == MeshDiscoveryMessage::FRAGMENT_STATUS)
+        {
+            handleFragmentStatus(packet_info.sender_id, payload, length);
+        }
         else if (msg_type == MeshDiscoveryMessage::NODE_PING_GATEWAY)
         {
             int node_idx = findNodeById(packet_info.sender_id);
             if (node_idx != -1)
             {
-                _known_nodes[node_idx].last_seen = millis();
-                uint8_t pong_payload[] = {(uint8_t)MeshDiscoveryMessage::GATEWAY_PONG_NODE};
-                _pjon_bus.strategy.set_receiver_mac(_known_nodes[node_idx].mac_addr);
-                _pjon_bus.set_receiver_id(packet_info.sender_id);
-                _pjon_bus.send(pong_payload, sizeof(pong_payload));
+                // Узел, получающий маяк, не просит ответа: подтверждением служит его бит в следующем маяке
+                if (actual_length == 0 || (actual_payload[0] & PING_FLAG_REPLY))
+                {
+                    uint8_t pong_payload[] = {(uint8_t)MeshDiscoveryMessage::GATEWAY_PONG_NODE};
+                    selectPeer(_known_nodes[node_idx].mac_addr);
+                    _pjon_bus.set_receiver_id(packet_info.sender_id);
+                    _pjon_bus.send(pong_payload, sizeof(pong_payload));
+                }
                 updateNodeStatus(packet_info.sender_id, true, "PING");
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-                Serial.printf(F("[GW RX] NODE_PING from Node ID %d. Sent PONG.\n"), packet_info.sender_id);
+                Serial.printf(F("[GW RX] NODE_PING from Node ID %d.\n"), packet_info.sender_id);
 #endif
             }
             else
@@ -1326,18 +2035,32 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
 #endif
             }
         }
+        else if (msg_type == MeshDiscoveryMessage::DATA)
+        {
+            handleData(packet_info.sender_id, payload, length);
+        }
+        else if (msg_type == MeshDiscoveryMessage::STREAM_ACK)
+        {
+            handleStreamAck(packet_info.sender_id, payload, length);
+        }
         else
         {
-            if (_user_receive_cb)
-            {
-                _user_receive_cb(packet_info.sender_id, payload, length, _user_receive_cb_custom_ptr);
-            }
+            deliverUserPayload(packet_info.sender_id, payload, length);
         }
     }
-    else if (_current_role == ROLE_NODE)
+    else if (_current_role == ROLE_NODE || _fsm_state == DiscoveryFSM::REQUEST_NODE_ID)
     {
+        // В REQUEST_NODE_ID роль еще ROLE_DISCOVERING, а NODE_ID_ASSIGN уже должен быть принят
         if (packet_info.sender_id == _gatewayPjonId)
         {
+            // Адресные данные и ответы на кадры узла заменяют пинг: шлюз слышит узел и продлевает его срок.
+            // Широковещательные кадры (объявление, маяк) этого не доказывают, поэтому пинг по ним не откладывается.
+            if (_fsm_state == DiscoveryFSM::OPERATIONAL_NODE &&
+                (msg_type == MeshDiscoveryMessage::DATA || msg_type == MeshDiscoveryMessage::STREAM_ACK ||
+                 msg_type == MeshDiscoveryMessage::FRAGMENT_STATUS))
+            {
+                noteGatewayAlive();
+            }
             if (msg_type == MeshDiscoveryMessage::NODE_ID_ASSIGN && actual_length >= 1 + ESP_NOW_ETH_ALEN)
             {
                 uint8_t assigned_id = actual_payload[0];
@@ -1353,16 +2076,19 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
 
                     sendNodeIdAck();
 
+                    // Повторная регистрация (узла нет в маяке шлюза) идет при активной связи: статус не меняется
+                    bool was_connected = _current_gateway_connected_status;
                     _current_role = ROLE_NODE;
                     saveConfigToNVS();
                     _fsm_state = DiscoveryFSM::OPERATIONAL_NODE;
+                    _node_id_retry_window_ms = NODE_ID_RETRY_MIN_MS;
                     _current_gateway_connected_status = true;
                     _last_ack_from_gateway_time = millis();
                     _failed_gateway_pings_count = 0;
                     _next_gateway_ping_time = millis() + _node_ping_gateway_interval_ms;
-                    if (_user_gateway_status_cb)
+                    if (!was_connected)
                     {
-                        _user_gateway_status_cb(true, _user_gateway_status_cb_custom_ptr);
+                        notifyGatewayStatus(true);
                     }
                 }
             }
@@ -1371,34 +2097,52 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
 #ifdef ROKOR_MESH_DEBUG_SERIAL
                 Serial.printf(F("[Node RX] GATEWAY_PONG from Gateway ID %d.\n"), _gatewayPjonId);
 #endif
-                _last_ack_from_gateway_time = millis();
-                _failed_gateway_pings_count = 0;
-                if (!_current_gateway_connected_status)
-                {
-                    _current_gateway_connected_status = true;
-                    if (_user_gateway_status_cb)
-                    {
-                        _user_gateway_status_cb(true, _user_gateway_status_cb_custom_ptr);
-                    }
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-                    Serial.println(F("[Node] Connection to gateway RESTORED."));
-#endif
-                }
+                noteGatewayAlive();
+            }
+            else if (msg_type == MeshDiscoveryMessage::LIVENESS_BEACON)
+            {
+                handleLivenessBeacon(actual_payload, actual_length);
             }
             else if (msg_type == MeshDiscoveryMessage::GATEWAY_ANNOUNCE)
             {
-                if (packet_info.sender_id == _gatewayPjonId && actual_length >= ESP_NOW_ETH_ALEN)
+                if (packet_info.sender_id == _gatewayPjonId && actual_length >= ESP_NOW_ETH_ALEN &&
+                    memcmp(_gateway_mac_addr, actual_payload, ESP_NOW_ETH_ALEN) != 0)
                 {
+                    // Шлюз с тем же ID и другим MAC: его место занял резервный шлюз. ID узла сохраняется.
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+                    Serial.printf(F("[Node RX] Gateway ID %d moved to MAC %02X:%02X:%02X:%02X:%02X:%02X\n"), _gatewayPjonId,
+                                  actual_payload[0], actual_payload[1], actual_payload[2], actual_payload[3], actual_payload[4], actual_payload[5]);
+#endif
+                    releasePeer(_gateway_mac_addr);
                     memcpy(_gateway_mac_addr, actual_payload, ESP_NOW_ETH_ALEN);
-                    addEspNowPeer(_gateway_mac_addr, _espNowChannel, strlen(_esp_now_pmk) > 0);
+                    saveConfigToNVS();
+                    _failed_gateway_pings_count = 0;
+                    _next_gateway_ping_time = millis();
                 }
             }
+            else if (msg_type == MeshDiscoveryMessage::DATA)
+            {
+                handleData(packet_info.sender_id, payload, length);
+            }
+            else if (msg_type == MeshDiscoveryMessage::STREAM_ACK)
+            {
+                handleStreamAck(packet_info.sender_id, payload, length);
+            }
+            else if (msg_type == MeshDiscoveryMessage::MULTICAST)
+            {
+                handleMulticast(packet_info, payload, length);
+            }
+            else if (msg_type == MeshDiscoveryMessage::FRAGMENT)
+            {
+                handleFragment(packet_info.sender_id, payload, length);
+            }
+            else if (msg_type == MeshDiscoveryMessage::FRAGMENT_STATUS)
+            {
+                handleFragmentStatus(packet_info.sender_id, payload, length);
+            }
             else
             {
-                if (_user_receive_cb)
-                {
-                    _user_receive_cb(packet_info.sender_id, payload, length, _user_receive_cb_custom_ptr);
-                }
+                deliverUserPayload(packet_info.sender_id, payload, length);
             }
         }
         else
@@ -1410,23 +2154,142 @@ void ROKOR_Mesh::actualPjonReceiver(uint8_t *payload, uint16_t length, const PJO
     }
 }
 
-void ROKOR_Mesh::actualPjonError(uint8_t code, uint16_t data)
+void ROKOR_Mesh::deliverUserPayload(uint8_t sender_id, const uint8_t *payload, uint16_t length)
 {
+    MeshDiscoveryMessage container = (MeshDiscoveryMessage)payload[0];
+    if (container == MeshDiscoveryMessage::APP_MESSAGE && length >= APP_HEADER_LEN)
+    {
+        dispatchUserMessage(sender_id, payload[1], payload + APP_HEADER_LEN, length - APP_HEADER_LEN);
+        return;
+    }
+    if (container != MeshDiscoveryMessage::BATCH)
+    {
+        // Сообщения приложения всегда идут с заголовком, поэтому неизвестный кадр не попадет в callback.
+        // Так приходят данные прошивок версии 1 без заголовка: они считаются и отбрасываются.
+        __atomic_fetch_add(&_rx_unknown_frame_count, 1, __ATOMIC_RELAXED);
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.printf(F("[PJON Error] Code: %d, Data: %d (Target ID)\n"), code, data);
+        Serial.printf(F("[PJON RX] Unknown frame type 0x%02X from ID %d. Dropping.\n"), payload[0], sender_id);
 #endif
-    if (code == PJON_CONNECTION_LOST)
-    {
+        return;
+    }
+
+    uint16_t offset = 1;
+    while (offset < length)
+    {
+        uint8_t item_length = payload[offset++];
+        if (item_length == 0 || offset + item_length > length)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[PJON RX] Malformed BATCH from ID %d at offset %d. Dropping rest.\n"), sender_id, offset - 1);
+#endif
+            return;
+        }
+        dispatchUserMessage(sender_id, payload[offset], payload + offset + 1, item_length - 1);
+        offset += item_length;
+    }
+}
+
+void ROKOR_Mesh::dispatchUserMessage(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length)
+{
+    if (!_message_routes[message_type].handler && !_user_receive_cb && !_user_batch_receive_cb)
+        return;
+    if (!_mesh_task_running)
+    {
+        invokeReceiveCallback(sender_id, message_type, payload, length, _rx_frame_time_us);
+        return;
+    }
+
+    MeshEvent event;
+    event.type = MeshEventType::RECEIVE;
+    event.id = sender_id;
+    event.message_type = message_type;
+    event.rx_time_us = _rx_frame_time_us;
+    event.length = length;
+    event.heap_data = nullptr;
+    if (length > sizeof(event.data))
+    {
+        event.heap_data = (uint8_t *)malloc(length);
+        if (!event.heap_data)
+        {
+            _event_overflow_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        memcpy(event.heap_data, payload, length);
+    }
+    else
+    {
+        memcpy(event.data, payload, length);
+    }
+    emitEvent(event);
+}
+
+void ROKOR_Mesh::invokeReceiveCallback(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length, uint32_t rx_time_us)
+{
+    const MessageRoute &route = _message_routes[message_type];
+    if (route.handler)
+    {
+        route.handler(sender_id, payload, length, route.custom_ptr);
+    }
+    else if (_user_batch_receive_cb)
+    {
+        collectRxRecord(sender_id, message_type, payload, length, rx_time_us);
+    }
+    else if (_user_receive_cb)
+    {
+        _user_receive_cb(sender_id, payload, length, _user_receive_cb_custom_ptr);
+    }
+}
+
+void ROKOR_Mesh::collectRxRecord(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length, uint32_t rx_time_us)
+{
+    // Пакет заполнен: отдаем накопленное раньше конца update()
+    if (_rx_batch_count == ROKOR_MESH_RX_BATCH_SIZE || _rx_batch_used + length > ROKOR_MESH_RX_BATCH_BUFFER_SIZE)
+    {
+        flushRxBatch();
+    }
+    ROKOR_Mesh_RxRecord &record = _rx_batch[_rx_batch_count++];
+    record.sender_id = sender_id;
+    record.message_type = message_type;
+    record.length = length;
+    record.rx_time_us = rx_time_us;
+    if (length > ROKOR_MESH_RX_BATCH_BUFFER_SIZE)
+    {
+        // Собранное из фрагментов сообщение больше буфера: отдельный пакет без копирования
+        record.payload = payload;
+        flushRxBatch();
+        return;
+    }
+    memcpy(&_rx_batch_buffer[_rx_batch_used], payload, length);
+    record.payload = &_rx_batch_buffer[_rx_batch_used];
+    _rx_batch_used += length;
+}
+
+void ROKOR_Mesh::flushRxBatch()
+{
+    if (_rx_batch_count == 0)
+        return;
+    if (_user_batch_receive_cb)
+    {
+        _user_batch_receive_cb(_rx_batch, _rx_batch_count, _user_batch_receive_cb_custom_ptr);
+    }
+    _rx_batch_count = 0;
+    _rx_batch_used = 0;
+}
+
+void ROKOR_Mesh::actualPjonError(uint8_t code, uint16_t data)
+{
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[PJON Error] Code: %d, Data: %d (Target ID)\n"), code, data);
+#endif
+    if (code == PJON_CONNECTION_LOST)
+    {
         if (_current_role == ROLE_NODE && data == _gatewayPjonId)
         {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.printf(F("[Node] PJON_CONNECTION_LOST with Gateway ID %d.\n"), _gatewayPjonId);
 #endif
             _current_gateway_connected_status = false;
-            if (_user_gateway_status_cb)
-            {
-                _user_gateway_status_cb(false, _user_gateway_status_cb_custom_ptr);
-            }
+            notifyGatewayStatus(false);
             _fsm_state = DiscoveryFSM::LISTEN_FOR_GATEWAY;
             _fsm_timer_start = millis();
             _gatewayPjonId = PJON_NOT_ASSIGNED;
@@ -1456,8 +2319,7 @@ void ROKOR_Mesh::operateAsNode()
         if (_current_gateway_connected_status)
         {
             _current_gateway_connected_status = false;
-            if (_user_gateway_status_cb)
-                _user_gateway_status_cb(false, _user_gateway_status_cb_custom_ptr);
+            notifyGatewayStatus(false);
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.println(F("[Node] Gateway ID became unassigned. Status set to disconnected."));
 #endif
@@ -1475,20 +2337,26 @@ void ROKOR_Mesh::operateAsNode()
         return;
     }
 
-    if (current_time >= _next_gateway_ping_time)
+    if (_gw_beacon_period_ms != 0 && current_time - _last_gw_beacon_time > LIVENESS_BEACON_MISSED_LIMIT * _gw_beacon_period_ms)
     {
-        if (_failed_gateway_pings_count >= _node_max_gateway_ping_attempts)
+        // Маяки пропали: проверяем шлюз сразу, не дожидаясь интервала опроса
+        _gw_beacon_period_ms = 0;
+        suspectGatewayLink(_gatewayPjonId);
+    }
+
+    if ((int32_t)(current_time - _next_gateway_ping_time) >= 0)
+    {
+        if (_failed_gateway_pings_count >= (_rejoin_probing ? REJOIN_MAX_PROBES : _node_max_gateway_ping_attempts))
         {
+            _rejoin_probing = false;
+            _gw_beacon_period_ms = 0;
             if (_current_gateway_connected_status)
             {
                 _current_gateway_connected_status = false;
 #ifdef ROKOR_MESH_DEBUG_SERIAL
                 Serial.printf(F("[Node] Gateway ID %d timed out after %d attempts. Disconnected.\n"), _gatewayPjonId, _node_max_gateway_ping_attempts);
 #endif
-                if (_user_gateway_status_cb)
-                {
-                    _user_gateway_status_cb(false, _user_gateway_status_cb_custom_ptr);
-                }
+                notifyGatewayStatus(false);
             }
             _fsm_state = DiscoveryFSM::LISTEN_FOR_GATEWAY;
             _fsm_timer_start = current_time;
@@ -1502,62 +2370,261 @@ void ROKOR_Mesh::operateAsNode()
             return;
         }
 
-        uint8_t ping_payload[] = {(uint8_t)MeshDiscoveryMessage::NODE_PING_GATEWAY};
+        // Пока приходят маяки, ответ не нужен; проверка шлюза (_rejoin_probing) ждет ответа
+        uint8_t ping_flags = (_rejoin_probing || _gw_beacon_period_ms == 0) ? PING_FLAG_REPLY : 0;
+        uint8_t ping_payload[] = {(uint8_t)MeshDiscoveryMessage::NODE_PING_GATEWAY, ping_flags};
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         Serial.printf(F("[Node] Sending PING to Gateway ID %d (Attempt %d).\n"), _gatewayPjonId, _failed_gateway_pings_count + 1);
 #endif
 
-        _pjon_bus.strategy.set_receiver_mac(_gateway_mac_addr);
+        selectPeer(_gateway_mac_addr);
         _pjon_bus.set_receiver_id(_gatewayPjonId);
         _pjon_bus.send(ping_payload, sizeof(ping_payload));
 
         _failed_gateway_pings_count++;
-        _next_gateway_ping_time = current_time + _node_ping_gateway_interval_ms;
+        _next_gateway_ping_time = current_time + (_rejoin_probing ? REJOIN_FIRST_RETRY_MS << (_failed_gateway_pings_count - 1) : _node_ping_gateway_interval_ms);
     }
 }
 
 void ROKOR_Mesh::operateAsGateway()
 {
     uint32_t current_time = millis();
-    if (current_time - _last_gateway_announce_time >= _gateway_announce_interval_ms)
+    if ((int32_t)(current_time - _next_gateway_announce_time) >= 0)
     {
         sendGatewayAnnounce();
-        _last_gateway_announce_time = current_time;
+        _announce_trickle_interval_ms = std::min(_announce_trickle_interval_ms * 2, _gateway_announce_interval_ms);
+        scheduleGatewayAnnounce();
+    }
+
+    if (_liveness_beacon_interval_ms != 0 && current_time - _last_liveness_beacon_time >= _liveness_beacon_interval_ms)
+    {
+        sendLivenessBeacon();
+        _last_liveness_beacon_time = current_time;
+    }
+
+    processSolicitReplies();
+    processStandbySync();
+    advanceLivenessWheel();
+    saveLeasesIfDue();
+}
+
+// --- Задача сети и события приложения ---
+void ROKOR_Mesh::setMeshTask(bool enabled, BaseType_t core, UBaseType_t priority, uint32_t stackSize)
+{
+    _mesh_task_enabled = enabled;
+    _mesh_task_core = core;
+    _mesh_task_priority = priority;
+    _mesh_task_stack_size = std::max(MESH_TASK_MIN_STACK_SIZE, stackSize);
+}
+
+uint32_t ROKOR_Mesh::getEventOverflowCount() const { return _event_overflow_count.load(std::memory_order_relaxed); }
+
+void ROKOR_Mesh::_meshTaskEntry(void *arg)
+{
+    ROKOR_Mesh *self = static_cast<ROKOR_Mesh *>(arg);
+    while (!self->_mesh_task_stop)
+    {
+        self->runMeshCycle();
+        self->waitForActivity(MESH_TASK_IDLE_WAIT_MS);
+    }
+    self->_mesh_task_running = false;
+    vTaskDelete(nullptr);
+}
+
+void ROKOR_Mesh::startMeshTask()
+{
+    if (!_event_queue)
+    {
+        _event_queue = xQueueCreate(ROKOR_MESH_EVENT_QUEUE_SIZE, sizeof(MeshEvent));
+    }
+    if (!_event_queue || !_activity_signal)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Mesh task: Failed to allocate event queue. Falling back to update() in loop()."));
+#endif
+        return;
+    }
+
+    // Флаг поднимается до запуска задачи, чтобы ее первые события уже шли через очередь
+    _mesh_task_stop = false;
+    _mesh_task_running = true;
+    if (xTaskCreatePinnedToCore(_meshTaskEntry, "rokor_mesh", _mesh_task_stack_size, this, _mesh_task_priority, &_mesh_task_handle, _mesh_task_core) != pdPASS)
+    {
+        _mesh_task_running = false;
+        _mesh_task_handle = nullptr;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Mesh task: Failed to create task. Falling back to update() in loop()."));
+#endif
+        return;
+    }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[ROKOR_Mesh] Mesh task started on core %d, priority %d.\n"), (int)_mesh_task_core, (int)_mesh_task_priority);
+#endif
+}
+
+void ROKOR_Mesh::stopMeshTask()
+{
+    if (!_mesh_task_running)
+        return;
+    _mesh_task_stop = true;
+    signalActivity();
+    while (_mesh_task_running)
+    {
+        delay(1);
+    }
+    _mesh_task_handle = nullptr;
+    // События, которые задача успела поставить в очередь, доставляются до остановки сети
+    dispatchEvents();
+}
+
+void ROKOR_Mesh::emitEvent(MeshEvent &event)
+{
+    if (!_mesh_task_running)
+    {
+        deliverEvent(event);
+        return;
+    }
+    if (xQueueSend(_event_queue, &event, 0) != pdTRUE)
+    {
+        if (event.heap_data)
+        {
+            free(event.heap_data);
+        }
+        _event_overflow_count.fetch_add(1, std::memory_order_relaxed);
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] Event queue full. Event %d dropped.\n"), (int)event.type);
+#endif
+    }
+}
+
+void ROKOR_Mesh::dispatchEvents()
+{
+    if (!_event_queue)
+        return;
+    MeshEvent event;
+    while (xQueueReceive(_event_queue, &event, 0) == pdTRUE)
+    {
+        deliverEvent(event);
     }
+}
 
-    if (current_time - _last_node_cleanup_time >= NODE_CLEANUP_INTERVAL_MS)
+void ROKOR_Mesh::deliverEvent(MeshEvent &event)
+{
+    switch (event.type)
     {
-        cleanupInactiveNodes();
-        _last_node_cleanup_time = current_time;
+    case MeshEventType::RECEIVE:
+        invokeReceiveCallback(event.id, event.message_type, event.heap_data ? event.heap_data : event.data, event.length, event.rx_time_us);
+        if (event.heap_data)
+        {
+            free(event.heap_data);
+            event.heap_data = nullptr;
+        }
+        break;
+    case MeshEventType::TX_COMPLETE:
+        if (_user_tx_complete_cb)
+        {
+            _user_tx_complete_cb(event.handle, event.id, event.status, _user_tx_complete_cb_custom_ptr);
+        }
+        break;
+    case MeshEventType::GATEWAY_STATUS:
+        if (_user_gateway_status_cb)
+        {
+            _user_gateway_status_cb(event.connected, _user_gateway_status_cb_custom_ptr);
+        }
+        break;
+    case MeshEventType::NODE_STATUS:
+        if (_user_node_status_cb)
+        {
+            _user_node_status_cb(event.id, event.connected, _user_node_status_cb_custom_ptr);
+        }
+        break;
+    case MeshEventType::MULTICAST_ACK:
+        if (_user_multicast_ack_cb)
+        {
+            _user_multicast_ack_cb(event.handle, event.id, _user_multicast_ack_cb_custom_ptr);
+        }
+        break;
     }
 }
 
+void ROKOR_Mesh::notifyGatewayStatus(bool connected)
+{
+    MeshEvent event;
+    event.type = MeshEventType::GATEWAY_STATUS;
+    event.connected = connected;
+    event.heap_data = nullptr;
+    emitEvent(event);
+}
+
+void ROKOR_Mesh::notifyNodeStatus(uint8_t node_id, bool connected)
+{
+    MeshEvent event;
+    event.type = MeshEventType::NODE_STATUS;
+    event.id = node_id;
+    event.connected = connected;
+    event.heap_data = nullptr;
+    emitEvent(event);
+}
+
+void ROKOR_Mesh::notifyTxComplete(ROKOR_Mesh_TxHandle handle, uint8_t destination_id, ROKOR_Mesh_TxStatus status)
+{
+    MeshEvent event;
+    event.type = MeshEventType::TX_COMPLETE;
+    event.id = destination_id;
+    event.handle = handle;
+    event.status = status;
+    event.heap_data = nullptr;
+    emitEvent(event);
+}
+
+void ROKOR_Mesh::notifyMulticastAck(ROKOR_Mesh_TxHandle handle, uint8_t node_id)
+{
+    MeshEvent event;
+    event.type = MeshEventType::MULTICAST_ACK;
+    event.id = node_id;
+    event.handle = handle;
+    event.heap_data = nullptr;
+    emitEvent(event);
+}
+
 // --- Управление узлами (для шлюза) ---
 void ROKOR_Mesh::initNodeManagement()
 {
     _known_nodes_count = 0;
     _next_available_node_id_candidate = 2;
-    for (int i = 0; i < MAX_NODES_PER_GATEWAY; ++i)
+    memset(_node_id_index, NODE_SLOT_NONE, sizeof(_node_id_index));
+    memset(_node_mac_hash, NODE_SLOT_NONE, sizeof(_node_mac_hash));
+    memset(_node_id_registered, 0, sizeof(_node_id_registered));
+    memset(_solicit_replies, 0, sizeof(_solicit_replies));
+    _standby_present = false;
+    _standby_snapshot_cursor = NODE_SLOT_NONE;
+    _standby_pending_count = 0;
+    _standby_tx_seq = 0;
+    _standby_synced = false;
+    _standby_loading = false;
+    _standby_rx_seq = 0;
+    _standby_probes_sent = 0;
+    _leases_dirty = false;
+    memset(_liveness_wheel, NODE_SLOT_NONE, sizeof(_liveness_wheel));
+    _liveness_cursor = 0;
+    _liveness_next_tick = millis() + LIVENESS_TICK_MS;
+    _node_free_head = 0;
+    for (int i = 0; i < ROKOR_MESH_MAX_NODES; ++i)
     {
         _known_nodes[i].pjon_id = PJON_NOT_ASSIGNED;
         memset(_known_nodes[i].mac_addr, 0, ESP_NOW_ETH_ALEN);
         _known_nodes[i].last_seen = 0;
         _known_nodes[i].id_assigned_this_session = false;
+        _known_nodes[i].wheel_next = (i + 1 < ROKOR_MESH_MAX_NODES) ? (uint8_t)(i + 1) : NODE_SLOT_NONE;
+        _known_nodes[i].wheel_prev = NODE_SLOT_NONE;
+        _known_nodes[i].wheel_bucket = NODE_SLOT_NONE;
+        resetPeerLink(_known_nodes[i].link);
     }
 }
 
 void ROKOR_Mesh::handleNodeIdRequest(const PJON_Packet_Info &request_info, const uint8_t *mac_from_payload)
 {
-    int existing_node_idx = -1;
-    for (int i = 0; i < _known_nodes_count; ++i)
-    {
-        if (memcmp(_known_nodes[i].mac_addr, mac_from_payload, ESP_NOW_ETH_ALEN) == 0)
-        {
-            existing_node_idx = i;
-            break;
-        }
-    }
-
+    int existing_node_idx = findNodeByMac(mac_from_payload);
     uint8_t assigned_id_to_send;
 
     if (existing_node_idx != -1)
@@ -1570,41 +2637,18 @@ void ROKOR_Mesh::handleNodeIdRequest(const PJON_Packet_Info &request_info, const
     }
     else
     {
-        if (_known_nodes_count >= MAX_NODES_PER_GATEWAY)
+        if (_known_nodes_count >= ROKOR_MESH_MAX_NODES)
         {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.println(F("[GW] Max nodes reached. Cannot assign new ID."));
 #endif
             return;
         }
-        assigned_id_to_send = PJON_NOT_ASSIGNED;
-        bool id_found = false;
-        for (int attempt = 0; attempt < 254; ++attempt)
-        {
-            bool candidate_taken = false;
-            if (_next_available_node_id_candidate == _myPjonId || _next_available_node_id_candidate == 0 || _next_available_node_id_candidate > 254)
-            {
-                _next_available_node_id_candidate = 2;
-            }
-            for (int i = 0; i < _known_nodes_count; ++i)
-            {
-                if (_known_nodes[i].pjon_id == _next_available_node_id_candidate)
-                {
-                    candidate_taken = true;
-                    break;
-                }
-            }
-            if (!candidate_taken)
-            {
-                assigned_id_to_send = _next_available_node_id_candidate;
-                id_found = true;
-                _next_available_node_id_candidate++;
-                break;
-            }
-            _next_available_node_id_candidate++;
-        }
-
-        if (!id_found)
+        // Узел, забытый шлюзом, сохраняет свой ID, если тот свободен по тем же правилам, что и при выдаче нового
+        // (не занят, не зарезервирован приложением, не служебный)
+        uint8_t current_id = request_info.sender_id;
+        assigned_id_to_send = isNodeIdFree(current_id) ? current_id : allocateNodeId();
+        if (assigned_id_to_send == PJON_NOT_ASSIGNED)
         {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.println(F("[GW] Could not find an available PJON ID for new node."));
@@ -1612,20 +2656,16 @@ void ROKOR_Mesh::handleNodeIdRequest(const PJON_Packet_Info &request_info, const
             return;
         }
 
-        _known_nodes[_known_nodes_count].pjon_id = assigned_id_to_send;
-        memcpy(_known_nodes[_known_nodes_count].mac_addr, mac_from_payload, ESP_NOW_ETH_ALEN);
-        _known_nodes[_known_nodes_count].last_seen = millis();
-        _known_nodes[_known_nodes_count].id_assigned_this_session = true;
-        _known_nodes_count++;
+        int node_idx = addNode(assigned_id_to_send, mac_from_payload);
+        _known_nodes[node_idx].id_assigned_this_session = true;
+        resetAnnounceTrickle();
 #ifdef ROKOR_MESH_DEBUG_SERIAL
         Serial.printf(F("[GW] New node. Assigned ID %d to MAC %02X:%02X.\n"), assigned_id_to_send, mac_from_payload[0], mac_from_payload[1]);
 #endif
     }
 
-    const uint8_t *mac_to_add_peer = (memcmp(request_info.sender_ethernet_address, _esp_now_null_mac, ESP_NOW_ETH_ALEN) != 0) ? request_info.sender_ethernet_address : mac_from_payload;
-    addEspNowPeer(mac_to_add_peer, _espNowChannel, strlen(_esp_now_pmk) > 0);
-
-    sendPjonIdAssignment(assigned_id_to_send, mac_to_add_peer);
+    const uint8_t *reply_mac = (memcmp(request_info.sender_ethernet_address, _esp_now_null_mac, ESP_NOW_ETH_ALEN) != 0) ? request_info.sender_ethernet_address : mac_from_payload;
+    sendPjonIdAssignment(assigned_id_to_send, reply_mac);
     updateNodeStatus(assigned_id_to_send, true, "ID_ASSIGN");
 }
 
@@ -1636,7 +2676,7 @@ void ROKOR_Mesh::sendPjonIdAssignment(uint8_t assigned_id, const uint8_t target_
     payload[1] = assigned_id;
     memcpy(&payload[2], target_mac, ESP_NOW_ETH_ALEN);
 
-    _pjon_bus.strategy.set_receiver_mac(target_mac);
+    selectPeer(target_mac);
     _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS); // Узел должен отфильтровать по MAC в payload
     _pjon_bus.send(payload, sizeof(payload));
 #ifdef ROKOR_MESH_DEBUG_SERIAL
@@ -1644,85 +2684,2120 @@ void ROKOR_Mesh::sendPjonIdAssignment(uint8_t assigned_id, const uint8_t target_
 #endif
 }
 
-void ROKOR_Mesh::cleanupInactiveNodes()
+uint32_t ROKOR_Mesh::nodeInactivityTimeout() const
+{
+    if (_node_inactivity_timeout_ms != 0)
+        return _node_inactivity_timeout_ms;
+    return _node_ping_gateway_interval_ms * (_node_max_gateway_ping_attempts + 1);
+}
+
+void ROKOR_Mesh::scheduleLiveness(uint8_t slot)
+{
+    NodeInfo &node = _known_nodes[slot];
+    int32_t ahead_ms = (int32_t)(node.last_seen + nodeInactivityTimeout() - _liveness_next_tick);
+    uint32_t ticks = (ahead_ms <= 0) ? 0 : ((uint32_t)ahead_ms + LIVENESS_TICK_MS - 1) / LIVENESS_TICK_MS;
+    // Дальний срок откладывается на неполный оборот (узел будет проверен и перенесен); корзина за курсором
+    // в этот момент может разбираться, поэтому она исключается
+    if (ticks > LIVENESS_WHEEL_SIZE - 2)
+        ticks = LIVENESS_WHEEL_SIZE - 2;
+    uint8_t bucket = (_liveness_cursor + ticks) & (LIVENESS_WHEEL_SIZE - 1);
+
+    node.wheel_bucket = bucket;
+    node.wheel_prev = NODE_SLOT_NONE;
+    node.wheel_next = _liveness_wheel[bucket];
+    if (node.wheel_next != NODE_SLOT_NONE)
+        _known_nodes[node.wheel_next].wheel_prev = slot;
+    _liveness_wheel[bucket] = slot;
+}
+
+void ROKOR_Mesh::unlinkLiveness(uint8_t slot)
+{
+    NodeInfo &node = _known_nodes[slot];
+    if (node.wheel_bucket == NODE_SLOT_NONE)
+        return;
+    if (node.wheel_prev != NODE_SLOT_NONE)
+        _known_nodes[node.wheel_prev].wheel_next = node.wheel_next;
+    else
+        _liveness_wheel[node.wheel_bucket] = node.wheel_next;
+    if (node.wheel_next != NODE_SLOT_NONE)
+        _known_nodes[node.wheel_next].wheel_prev = node.wheel_prev;
+    node.wheel_bucket = NODE_SLOT_NONE;
+}
+
+void ROKOR_Mesh::advanceLivenessWheel()
 {
     uint32_t current_time = millis();
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.println(F("[GW] Running cleanup for inactive nodes..."));
-#endif
-    for (int i = 0; i < _known_nodes_count; ++i)
+    uint32_t timeout = nodeInactivityTimeout();
+    // За один вызов - не более оборота колеса (после долгой паузы update() каждая корзина разбирается один раз)
+    for (uint8_t n = 0; n < LIVENESS_WHEEL_SIZE && (int32_t)(current_time - _liveness_next_tick) >= 0; ++n)
     {
-        if (current_time - _known_nodes[i].last_seen > NODE_INACTIVITY_THRESHOLD_MS)
+        uint8_t bucket = _liveness_cursor;
+        _liveness_cursor = (_liveness_cursor + 1) & (LIVENESS_WHEEL_SIZE - 1);
+        _liveness_next_tick += LIVENESS_TICK_MS;
+
+        // Узлы снимаются по одному: обработчик статуса может изменить таблицу узлов
+        uint8_t slot;
+        while ((slot = _liveness_wheel[bucket]) != NODE_SLOT_NONE)
         {
+            unlinkLiveness(slot);
+            NodeInfo &node = _known_nodes[slot];
+            if ((int32_t)(current_time - node.last_seen) < (int32_t)timeout)
+            {
+                scheduleLiveness(slot);
+                continue;
+            }
 #ifdef ROKOR_MESH_DEBUG_SERIAL
             Serial.printf(F("[GW] Node ID %d (MAC %02X:%02X) inactive. Removing.\n"),
-                          _known_nodes[i].pjon_id, _known_nodes[i].mac_addr[0], _known_nodes[i].mac_addr[1]);
+                          node.pjon_id, node.mac_addr[0], node.mac_addr[1]);
 #endif
-
-            updateNodeStatus(_known_nodes[i].pjon_id, false, "TIMEOUT");
-            esp_now_del_peer(_known_nodes[i].mac_addr);
-
-            for (int j = i; j < _known_nodes_count - 1; ++j)
-            {
-                _known_nodes[j] = _known_nodes[j + 1];
-            }
-            _known_nodes_count--;
-            i--;
+            uint8_t node_id = node.pjon_id;
+            releasePeer(node.mac_addr);
+            removeNode(slot);
+            updateNodeStatus(node_id, false, "TIMEOUT");
         }
     }
+    if ((int32_t)(current_time - _liveness_next_tick) >= 0)
+    {
+        _liveness_next_tick = current_time + LIVENESS_TICK_MS;
+    }
 }
 
-int ROKOR_Mesh::findNodeByMac(const uint8_t mac[6])
+int ROKOR_Mesh::findNodeByMac(const uint8_t mac[6]) const
 {
-    for (int i = 0; i < _known_nodes_count; ++i)
+    uint16_t pos = hashMac(mac);
+    while (_node_mac_hash[pos] != NODE_SLOT_NONE)
     {
-        if (memcmp(_known_nodes[i].mac_addr, mac, ESP_NOW_ETH_ALEN) == 0)
+        uint8_t slot = _node_mac_hash[pos];
+        if (memcmp(_known_nodes[slot].mac_addr, mac, ESP_NOW_ETH_ALEN) == 0)
         {
-            return i;
+            return slot;
         }
+        pos = (pos + 1) & (NODE_MAC_HASH_SIZE - 1);
     }
     return -1;
 }
 
-int ROKOR_Mesh::findNodeById(uint8_t id)
+int ROKOR_Mesh::findNodeById(uint8_t id) const
+{
+    uint8_t slot = _node_id_index[id];
+    return (slot == NODE_SLOT_NONE) ? -1 : slot;
+}
+
+int ROKOR_Mesh::addNode(uint8_t node_id, const uint8_t mac[6])
 {
-    if (id == PJON_NOT_ASSIGNED)
+    if (_node_free_head == NODE_SLOT_NONE)
         return -1;
-    for (int i = 0; i < _known_nodes_count; ++i)
+    uint8_t slot = _node_free_head;
+    NodeInfo &node = _known_nodes[slot];
+    _node_free_head = node.wheel_next;
+    _known_nodes_count++;
+    node.pjon_id = node_id;
+    memcpy(node.mac_addr, mac, ESP_NOW_ETH_ALEN);
+    node.last_seen = millis();
+    node.id_assigned_this_session = false;
+    resetPeerLink(node.link);
+    _node_id_index[node_id] = slot;
+    _node_id_registered[node_id >> 5] |= 1u << (node_id & 31);
+    insertMacHash(slot);
+    scheduleLiveness(slot);
+    markLeasesDirty();
+    queueStandbyChange(node_id, mac);
+    return slot;
+}
+
+uint8_t ROKOR_Mesh::allocateNodeId()
+{
+    // Поиск идет от курсора к концу и затем с начала, чтобы освобожденный ID не выдавался сразу повторно
+    for (uint8_t pass = 0; pass < 2; ++pass)
     {
-        if (_known_nodes[i].pjon_id == id)
+        uint8_t from = (pass == 0) ? _next_available_node_id_candidate : 0;
+        for (uint8_t w = from >> 5; w < NODE_ID_WORDS; ++w)
         {
-            return i;
+            uint32_t free_bits = freeNodeIdBits(w);
+            if (w == (from >> 5))
+                free_bits &= ~0u << (from & 31);
+            if (free_bits)
+            {
+                uint8_t id = (uint8_t)(w * 32 + __builtin_ctz(free_bits));
+                _next_available_node_id_candidate = id + 1;
+                return id;
+            }
         }
     }
-    return -1;
+    return PJON_NOT_ASSIGNED;
 }
 
-void ROKOR_Mesh::updateNodeStatus(uint8_t nodeId, bool isConnected, const char *reason)
+uint32_t ROKOR_Mesh::freeNodeIdBits(uint8_t word) const
+{
+    uint32_t free_bits = ~(_node_id_registered[word] | _node_id_reserved[word]);
+    // Не выдаются: 0 (broadcast), 255, ID шлюза по умолчанию (его займет шлюз после перевыборов) и свой ID
+    if (word == 0)
+        free_bits &= ~(1u << PJON_BROADCAST_ADDRESS);
+    if (word == NODE_ID_WORDS - 1)
+        free_bits &= ~(1u << (PJON_NOT_ASSIGNED & 31));
+    if (word == (ROKOR_MESH_DEFAULT_GATEWAY_ID >> 5))
+        free_bits &= ~(1u << (ROKOR_MESH_DEFAULT_GATEWAY_ID & 31));
+    if (word == (_myPjonId >> 5))
+        free_bits &= ~(1u << (_myPjonId & 31));
+    return free_bits;
+}
+
+bool ROKOR_Mesh::isNodeIdFree(uint8_t id) const { return (freeNodeIdBits(id >> 5) & (1u << (id & 31))) != 0; }
+
+void ROKOR_Mesh::removeNode(uint8_t slot)
 {
-    if (_user_node_status_cb)
+    NodeInfo &node = _known_nodes[slot];
+    queueStandbyChange(node.pjon_id, nullptr);
+    unlinkLiveness(slot);
+    _node_id_index[node.pjon_id] = NODE_SLOT_NONE;
+    _node_id_registered[node.pjon_id >> 5] &= ~(1u << (node.pjon_id & 31));
+    eraseMacHash(slot);
+    node.pjon_id = PJON_NOT_ASSIGNED;
+    node.wheel_next = _node_free_head;
+    _node_free_head = slot;
+    _known_nodes_count--;
+    markLeasesDirty();
+}
+
+uint16_t ROKOR_Mesh::hashMac(const uint8_t mac[6])
+{
+    // Младшие байты MAC (номер устройства) различаются сильнее всего; умножение перемешивает их в старшие биты
+    uint32_t h = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) ^ ((uint32_t)mac[0] << 8 | mac[1]);
+    h *= 2654435761u;
+    return (h >> 16) & (NODE_MAC_HASH_SIZE - 1);
+}
+
+void ROKOR_Mesh::insertMacHash(uint8_t slot)
+{
+    uint16_t pos = hashMac(_known_nodes[slot].mac_addr);
+    while (_node_mac_hash[pos] != NODE_SLOT_NONE)
     {
-        _user_node_status_cb(nodeId, isConnected, _user_node_status_cb_custom_ptr);
+        pos = (pos + 1) & (NODE_MAC_HASH_SIZE - 1);
     }
-#ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.printf("[GW Node Status] Node ID %d is now %s. Reason: %s\n", nodeId, isConnected ? "CONNECTED" : "DISCONNECTED", reason);
-#endif
+    _node_mac_hash[pos] = slot;
 }
 
-// --- Служебные сообщения ---
-void ROKOR_Mesh::sendGatewayAnnounce()
+void ROKOR_Mesh::eraseMacHash(uint8_t slot)
 {
-    uint8_t payload[1 + ESP_NOW_ETH_ALEN];
-    payload[0] = (uint8_t)MeshDiscoveryMessage::GATEWAY_ANNOUNCE;
-    memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
+    const uint16_t mask = NODE_MAC_HASH_SIZE - 1;
+    uint16_t hole = hashMac(_known_nodes[slot].mac_addr);
+    while (_node_mac_hash[hole] != slot)
+    {
+        if (_node_mac_hash[hole] == NODE_SLOT_NONE)
+            return;
+        hole = (hole + 1) & mask;
+    }
+    _node_mac_hash[hole] = NODE_SLOT_NONE;
 
-    addEspNowPeer(_esp_now_broadcast_mac, _espNowChannel, strlen(_esp_now_pmk) > 0);
-    _pjon_bus.strategy.set_receiver_mac(_esp_now_broadcast_mac);
-    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
-    _pjon_bus.send(payload, sizeof(payload));
+    // Удаление без меток: сдвигаем назад записи цепочки, чей исходный слот не лежит между дыркой и ними
+    uint16_t pos = (hole + 1) & mask;
+    while (_node_mac_hash[pos] != NODE_SLOT_NONE)
+    {
+        uint16_t home = hashMac(_known_nodes[_node_mac_hash[pos]].mac_addr);
+        if (((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+            _node_mac_hash[hole] = _node_mac_hash[pos];
+            _node_mac_hash[pos] = NODE_SLOT_NONE;
+            hole = pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+bool ROKOR_Mesh::registerNode(uint8_t nodeId, const uint8_t mac[6])
+{
+    if (_current_role != ROLE_GATEWAY || !mac || nodeId == PJON_BROADCAST_ADDRESS || nodeId == PJON_NOT_ASSIGNED || nodeId == _myPjonId)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] registerNode: Invalid ID %d or role is not gateway.\n"), nodeId);
+#endif
+        return false;
+    }
+    int by_id = findNodeById(nodeId);
+    int by_mac = findNodeByMac(mac);
+    if (by_id != -1 && by_id != by_mac)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] registerNode: ID %d belongs to another MAC.\n"), nodeId);
+#endif
+        return false;
+    }
+    if (by_id == -1)
+    {
+        if (by_mac != -1)
+        {
+            // Узел с этим MAC был известен под другим ID
+            removeNode(by_mac);
+        }
+        if (addNode(nodeId, mac) == -1)
+        {
 #ifdef ROKOR_MESH_DEBUG_SERIAL
-    Serial.printf(F("[GW] Sent GATEWAY_ANNOUNCE. My ID: %d\n"), _myPjonId);
+            Serial.println(F("[ROKOR_Mesh] registerNode: Max nodes reached."));
 #endif
+            return false;
+        }
+    }
+    else
+    {
+        _known_nodes[by_id].last_seen = millis();
+    }
+    return true;
+}
+
+uint8_t ROKOR_Mesh::assignNodeId(const uint8_t mac[6])
+{
+    if (_current_role != ROLE_GATEWAY || !mac)
+        return PJON_NOT_ASSIGNED;
+    int node_idx = findNodeByMac(mac);
+    if (node_idx == -1)
+    {
+        uint8_t node_id = (_known_nodes_count < ROKOR_MESH_MAX_NODES) ? allocateNodeId() : PJON_NOT_ASSIGNED;
+        if (node_id == PJON_NOT_ASSIGNED)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.println(F("[ROKOR_Mesh] assignNodeId: No free node slot or ID."));
+#endif
+            return PJON_NOT_ASSIGNED;
+        }
+        node_idx = addNode(node_id, mac);
+    }
+    return _known_nodes[node_idx].pjon_id;
+}
+
+bool ROKOR_Mesh::reserveNodeIds(uint8_t firstId, uint8_t lastId)
+{
+    if (firstId == PJON_BROADCAST_ADDRESS || lastId == PJON_NOT_ASSIGNED || firstId > lastId)
+        return false;
+    for (uint16_t id = firstId; id <= lastId; ++id)
+    {
+        _node_id_reserved[id >> 5] |= 1u << (id & 31);
+    }
+    return true;
+}
+
+void ROKOR_Mesh::clearReservedNodeIds() { memset(_node_id_reserved, 0, sizeof(_node_id_reserved)); }
+
+uint8_t ROKOR_Mesh::getNodeIdByMac(const uint8_t mac[6]) const
+{
+    if (!mac)
+        return PJON_NOT_ASSIGNED;
+    int node_idx = findNodeByMac(mac);
+    return (node_idx == -1) ? PJON_NOT_ASSIGNED : _known_nodes[node_idx].pjon_id;
+}
+
+uint8_t ROKOR_Mesh::getNodeCount() const { return _known_nodes_count; }
+
+void ROKOR_Mesh::updateNodeStatus(uint8_t nodeId, bool isConnected, const char *reason)
+{
+    notifyNodeStatus(nodeId, isConnected);
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf("[GW Node Status] Node ID %d is now %s. Reason: %s\n", nodeId, isConnected ? "CONNECTED" : "DISCONNECTED", reason);
+#endif
+}
+
+// --- Очередь отправки ---
+void ROKOR_Mesh::initTxQueue()
+{
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    for (uint8_t i = 0; i < ROKOR_MESH_TX_QUEUE_SIZE; ++i)
+    {
+        _tx_queue[i].state = TxSlotState::FREE;
+        _tx_queue[i].handle = ROKOR_MESH_INVALID_TX_HANDLE;
+        _tx_queue[i].data = _tx_queue[i].frame + DATA_HEADER_LEN;
+    }
+    _tx_head = 0;
+    _tx_tail = 0;
+    _tx_count = 0;
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+}
+
+bool ROKOR_Mesh::validateOutgoing(uint8_t destinationId, uint16_t length, uint16_t max_length)
+{
+    if (!_is_begun || (_current_role != ROLE_NODE && _current_role != ROLE_GATEWAY))
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendMessage: Network not active or role not operational."));
+#endif
+        return false;
+    }
+    if (destinationId == PJON_NOT_ASSIGNED || destinationId > 254)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendMessage: Invalid destination ID."));
+#endif
+        return false;
+    }
+    if (length == 0)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendMessage: Empty payload."));
+#endif
+        return false;
+    }
+    if (length > max_length)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] sendMessage: Payload too long (%d > %d).\n"), length, max_length);
+#endif
+        return false;
+    }
+
+    uint8_t target_mac[ESP_NOW_ETH_ALEN];
+    return resolveDestinationMac(destinationId, target_mac);
+}
+
+int ROKOR_Mesh::reserveTxSlot(uint8_t destinationId)
+{
+    // Слот занимается под критической секцией: очередь может пополняться
+    // из callback-ов и прерываний параллельно с разбором в update().
+    int slot_idx = -1;
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    if (_tx_count < ROKOR_MESH_TX_QUEUE_SIZE)
+    {
+        slot_idx = _tx_head;
+        TxSlot &slot = _tx_queue[slot_idx];
+        slot.handle = _tx_next_handle++;
+        if (_tx_next_handle == ROKOR_MESH_INVALID_TX_HANDLE)
+        {
+            _tx_next_handle = 1;
+        }
+        slot.destination_id = destinationId;
+        slot.attempts = 0;
+        slot.length = 0;
+        slot.batch_open = false;
+        slot.seq_assigned = false;
+        slot.stream_in_flight = false;
+        slot.state = TxSlotState::RESERVED;
+        _tx_head = (_tx_head + 1) % ROKOR_MESH_TX_QUEUE_SIZE;
+        _tx_count++;
+    }
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    if (slot_idx == -1)
+    {
+        Serial.printf(F("[ROKOR_Mesh] sendMessage: TX queue full (%d). Message to ID %d dropped.\n"), ROKOR_MESH_TX_QUEUE_SIZE, destinationId);
+    }
+#endif
+    return slot_idx;
+}
+
+int ROKOR_Mesh::findTxSlot(ROKOR_Mesh_TxHandle handle)
+{
+    if (handle == ROKOR_MESH_INVALID_TX_HANDLE)
+        return -1;
+    for (uint8_t i = 0; i < ROKOR_MESH_TX_QUEUE_SIZE; ++i)
+    {
+        if (_tx_queue[i].state != TxSlotState::FREE && _tx_queue[i].handle == handle)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool ROKOR_Mesh::resolveDestinationMac(uint8_t destinationId, uint8_t *target_mac)
+{
+    if (_current_role == ROLE_GATEWAY)
+    {
+        if (destinationId == PJON_BROADCAST_ADDRESS)
+        {
+            memcpy(target_mac, _esp_now_broadcast_mac, ESP_NOW_ETH_ALEN);
+            return true;
+        }
+        int node_idx = findNodeById(destinationId);
+        if (node_idx != -1)
+        {
+            memcpy(target_mac, _known_nodes[node_idx].mac_addr, ESP_NOW_ETH_ALEN);
+            return true;
+        }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] sendMessage (GW): Destination node ID %d not found or MAC unknown.\n"), destinationId);
+#endif
+        return false;
+    }
+    else if (_current_role == ROLE_NODE)
+    {
+        if (destinationId != _gatewayPjonId)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[ROKOR_Mesh] sendMessage (Node): Cannot send to ID %d. Nodes can only send to gateway.\n"), destinationId);
+#endif
+            return false;
+        }
+        if (memcmp(_gateway_mac_addr, _esp_now_null_mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.println(F("[ROKOR_Mesh] sendMessage (Node): Gateway MAC unknown."));
+#endif
+            return false;
+        }
+        memcpy(target_mac, _gateway_mac_addr, ESP_NOW_ETH_ALEN);
+        return true;
+    }
+    return false;
+}
+
+void ROKOR_Mesh::processTxQueue()
+{
+    if (_tx_count == 0 || !_pjon_bus.is_listening())
+        return;
+
+    uint32_t current_time = millis();
+    uint8_t pending_count = _tx_count;
+    uint8_t stream_burst[ROKOR_MESH_TX_QUEUE_SIZE];
+    uint8_t stream_burst_count = 0;
+    uint8_t stream_in_flight = 0;
+
+    for (uint8_t i = 0; i < pending_count; ++i)
+    {
+        uint8_t slot_idx = (_tx_tail + i) % ROKOR_MESH_TX_QUEUE_SIZE;
+        TxSlot &slot = _tx_queue[slot_idx];
+        if (slot.state != TxSlotState::PENDING)
+            continue;
+
+        if (current_time - slot.enqueue_time >= _tx_timeout_ms)
+        {
+            completeTxSlot(slot_idx, TX_STATUS_TIMEOUT);
+            continue;
+        }
+
+        if (slot.stream_in_flight)
+        {
+            if (micros() - slot.stream_sent_us < linkRtoMs(slot.destination_id) * 1000UL * slot.attempts)
+            {
+                stream_in_flight++;
+                continue;
+            }
+            // STREAM_ACK не подтвердил кадр: отправляем его повторно
+            slot.stream_in_flight = false;
+        }
+        if ((int32_t)(current_time - slot.next_attempt_time) < 0)
+            continue;
+
+        // Одноадресные сообщения уходят кадрами DATA с номером и ждут STREAM_ACK в следующих вызовах update(),
+        // а не внутри send_packet(). Широковещательные кадры идут как есть: их никто не подтверждает.
+        if (slot.destination_id != PJON_BROADCAST_ADDRESS)
+        {
+            if (slot.attempts >= TX_MAX_ATTEMPTS)
+            {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+                Serial.printf(F("[ROKOR_Mesh] DATA %u to ID %d failed after %d attempts.\n"), slot.seq, slot.destination_id, slot.attempts);
+#endif
+                suspectGatewayLink(slot.destination_id);
+                completeTxSlot(slot_idx, TX_STATUS_FAIL);
+                continue;
+            }
+            PeerLink *peer = findPeerLink(slot.destination_id);
+            if (!peer)
+            {
+                completeTxSlot(slot_idx, TX_STATUS_FAIL);
+                continue;
+            }
+            if (slot.seq_assigned || streamSeqAvailable(slot.destination_id, *peer))
+            {
+                stream_burst[stream_burst_count++] = slot_idx;
+            }
+            continue;
+        }
+
+        if (slot.batch_open)
+        {
+            closeBatch(slot);
+        }
+
+        uint8_t target_mac[ESP_NOW_ETH_ALEN];
+        if (!resolveDestinationMac(slot.destination_id, target_mac))
+        {
+            completeTxSlot(slot_idx, TX_STATUS_FAIL);
+            continue;
+        }
+
+        selectPeer(target_mac);
+        _pjon_bus.set_receiver_id(slot.destination_id);
+        uint16_t response = _pjon_bus.send_packet(slot.data, slot.length);
+        if (response == PJON_ACK)
+        {
+            if (startMulticastTrack(slot.handle))
+            {
+                slot.state = TxSlotState::DONE; // Итог сообщит processMulticastAcks() по ответам адресатов
+            }
+            else
+            {
+                completeTxSlot(slot_idx, TX_STATUS_ACK);
+            }
+        }
+        else if (response != PJON_BUSY && ++slot.attempts >= TX_MAX_ATTEMPTS)
+        {
+            MulticastTrack *track = findMulticastTrack(slot.handle);
+            if (track)
+                track->handle = ROKOR_MESH_INVALID_TX_HANDLE;
+            completeTxSlot(slot_idx, TX_STATUS_FAIL);
+        }
+        else
+        {
+            slot.next_attempt_time = current_time + TX_BUSY_RETRY_MS;
+        }
+    }
+
+    // Кадры DATA уходят пачкой в пределах окна; повторы (старшие слоты) идут первыми.
+    // Без надежного потока окно равно одному кадру: следующий ждет STREAM_ACK на предыдущий.
+    uint8_t window = _stream_enabled ? _stream_window : 1;
+    if (stream_in_flight < window && stream_burst_count > 0)
+    {
+        sendStreamBurst(stream_burst, std::min(stream_burst_count, (uint8_t)(window - stream_in_flight)));
+    }
+
+    // Освобождаем завершенные слоты в начале кольца
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    while (_tx_count > 0 && _tx_queue[_tx_tail].state == TxSlotState::DONE)
+    {
+        _tx_queue[_tx_tail].state = TxSlotState::FREE;
+        _tx_tail = (_tx_tail + 1) % ROKOR_MESH_TX_QUEUE_SIZE;
+        _tx_count--;
+    }
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::appendToBatch(uint8_t destinationId, uint8_t message_type, const uint8_t *payload, uint16_t length)
+{
+    ROKOR_Mesh_TxHandle handle = ROKOR_MESH_INVALID_TX_HANDLE;
+    uint32_t current_time = millis();
+
+    // Дописываем в открытый кадр того же адресата, если в нем есть место
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    for (uint8_t i = 0; i < _tx_count; ++i)
+    {
+        TxSlot &slot = _tx_queue[(_tx_tail + i) % ROKOR_MESH_TX_QUEUE_SIZE];
+        if (slot.state != TxSlotState::PENDING || !slot.batch_open || slot.destination_id != destinationId)
+            continue;
+        if (slot.length + 2 + length <= TX_FRAME_SIZE)
+        {
+            slot.data[slot.length++] = (uint8_t)(1 + length);
+            slot.data[slot.length++] = message_type;
+            memcpy(&slot.data[slot.length], payload, length);
+            slot.length += length;
+            handle = slot.handle;
+        }
+        if (handle == ROKOR_MESH_INVALID_TX_HANDLE || slot.length + 3 > TX_FRAME_SIZE)
+        {
+            // Кадр заполнен: закрываем его и отправляем без ожидания конца окна
+            slot.batch_open = false;
+            slot.next_attempt_time = current_time;
+        }
+        break;
+    }
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+    if (handle != ROKOR_MESH_INVALID_TX_HANDLE)
+    {
+        return handle;
+    }
+
+    int slot_idx = reserveTxSlot(destinationId);
+    if (slot_idx == -1)
+    {
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    TxSlot &slot = _tx_queue[slot_idx];
+    slot.data[0] = (uint8_t)MeshDiscoveryMessage::BATCH;
+    slot.data[1] = (uint8_t)(1 + length);
+    slot.data[2] = message_type;
+    memcpy(&slot.data[3], payload, length);
+
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    slot.length = 3 + length;
+    slot.enqueue_time = current_time;
+    slot.next_attempt_time = current_time + _batch_window_ms;
+    slot.batch_open = true;
+    slot.state = TxSlotState::PENDING;
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+    return slot.handle;
+}
+
+void ROKOR_Mesh::closeBatch(TxSlot &slot)
+{
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    slot.batch_open = false;
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+
+    // Одиночное сообщение отправляется обычным кадром APP_MESSAGE: [BATCH][len][тип][данные] -> [APP_MESSAGE][тип][данные]
+    uint8_t item_length = slot.data[1];
+    if (slot.length == 2 + item_length)
+    {
+        slot.data[0] = (uint8_t)MeshDiscoveryMessage::APP_MESSAGE;
+        memmove(&slot.data[1], &slot.data[2], item_length);
+        slot.length = 1 + item_length;
+    }
+}
+
+void ROKOR_Mesh::completeTxSlot(uint8_t slot_idx, ROKOR_Mesh_TxStatus status)
+{
+    TxSlot &slot = _tx_queue[slot_idx];
+    slot.state = TxSlotState::DONE;
+    if (status == TX_STATUS_ACK)
+    {
+        noteLinkAlive(slot.destination_id);
+    }
+    notifyTxComplete(slot.handle, slot.destination_id, status);
+}
+
+void ROKOR_Mesh::noteLinkAlive(uint8_t peer_id)
+{
+    if (_current_role == ROLE_GATEWAY)
+    {
+        int node_idx = findNodeById(peer_id);
+        if (node_idx != -1)
+        {
+            _known_nodes[node_idx].last_seen = millis();
+        }
+    }
+    else if (_current_role == ROLE_NODE && peer_id == _gatewayPjonId && _fsm_state == DiscoveryFSM::OPERATIONAL_NODE)
+    {
+        noteGatewayAlive();
+    }
+}
+
+void ROKOR_Mesh::noteGatewayAlive()
+{
+    confirmGatewayLink();
+    // Пинг нужен только после простоя: каждый обмен со шлюзом откладывает его на полный интервал
+    _next_gateway_ping_time = millis() + _node_ping_gateway_interval_ms;
+}
+
+void ROKOR_Mesh::confirmGatewayLink()
+{
+    uint32_t current_time = millis();
+    _last_ack_from_gateway_time = current_time;
+    _failed_gateway_pings_count = 0;
+    if (_rejoin_probing)
+    {
+        _rejoin_probing = false;
+        _next_gateway_ping_time = current_time + _node_ping_gateway_interval_ms;
+    }
+    if (!_current_gateway_connected_status)
+    {
+        _current_gateway_connected_status = true;
+        notifyGatewayStatus(true);
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[Node] Connection to gateway RESTORED."));
+#endif
+    }
+}
+
+void ROKOR_Mesh::handleLivenessBeacon(const uint8_t *payload, uint16_t length)
+{
+    if (length < 4 || length < 4 + payload[3])
+        return;
+    uint8_t seq = payload[0];
+    uint16_t period_ms = (uint16_t)payload[1] | ((uint16_t)payload[2] << 8);
+    uint8_t bitmap_len = payload[3];
+    const uint8_t *bitmap = payload + 4;
+    if (_gw_beacon_period_ms != 0 && seq == _gw_beacon_seq)
+        return; // Повтор уже принятого маяка
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    if (_gw_beacon_period_ms != 0 && seq != (uint8_t)(_gw_beacon_seq + 1))
+    {
+        Serial.printf(F("[Node RX] %d liveness beacon(s) lost.\n"), (uint8_t)(seq - _gw_beacon_seq - 1));
+    }
+#endif
+    _gw_beacon_seq = seq;
+    _gw_beacon_period_ms = period_ms;
+    _last_gw_beacon_time = millis();
+    if (_fsm_state != DiscoveryFSM::OPERATIONAL_NODE)
+        return;
+
+    // Карта - ID, зарегистрированные в таблице шлюза, а не узлы, слышные шлюзу недавно
+    uint8_t byte_idx = _myPjonId >> 3;
+    if (byte_idx < bitmap_len && (bitmap[byte_idx] & (1 << (_myPjonId & 7))))
+    {
+        _node_id_retry_window_ms = NODE_ID_RETRY_MIN_MS;
+        confirmGatewayLink();
+    }
+    else if (!_forced_role_active)
+    {
+        // Шлюз удалил узел из таблицы (например, по неактивности или после перезагрузки без аренд): регистрируемся заново.
+        // Первый запрос сразу, следующие - не чаще окна повтора, а не на каждый маяк
+        uint32_t current_time = millis();
+        if (_node_id_retry_window_ms == NODE_ID_RETRY_MIN_MS || (int32_t)(current_time - _next_node_id_request_time) >= 0)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[Node RX] ID %d missing from gateway beacon. Re-registering.\n"), _myPjonId);
+#endif
+            sendNodeIdRequest();
+        }
+    }
+}
+
+void ROKOR_Mesh::suspectGatewayLink(uint8_t peer_id)
+{
+    if (_current_role != ROLE_NODE || peer_id != _gatewayPjonId || _fsm_state != DiscoveryFSM::OPERATIONAL_NODE || _rejoin_probing)
+        return;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.println(F("[Node] Delivery to gateway failed. Probing gateway."));
+#endif
+    // Не ждем интервала опроса: короткие пинги подтвердят связь или за ~620 мс переведут узел к поиску шлюза
+    _rejoin_probing = true;
+    _failed_gateway_pings_count = 0;
+    _next_gateway_ping_time = millis();
+}
+
+// --- Надежный поток ---
+void ROKOR_Mesh::resetPeerLink(PeerLink &peer)
+{
+    // Случайный начальный номер: после перезапуска отправителя получатель не примет новые кадры за повторы
+    peer.tx_next_seq = (uint16_t)esp_random();
+    peer.rx_highest_seq = 0;
+    peer.rx_bitmap = 0;
+    peer.srtt_us = 0;
+    peer.rttvar_us = 0;
+    peer.rtt_samples = 0;
+}
+
+void ROKOR_Mesh::addRttSample(uint8_t peer_id, uint32_t rtt_us)
+{
+    PeerLink *peer = findPeerLink(peer_id);
+    if (!peer)
+        return;
+    if (peer->rtt_samples == 0)
+    {
+        peer->srtt_us = rtt_us;
+        peer->rttvar_us = rtt_us / 2;
+    }
+    else
+    {
+        uint32_t deviation = (rtt_us > peer->srtt_us) ? rtt_us - peer->srtt_us : peer->srtt_us - rtt_us;
+        peer->rttvar_us = peer->rttvar_us - peer->rttvar_us / 4 + deviation / 4;
+        peer->srtt_us = peer->srtt_us - peer->srtt_us / 8 + rtt_us / 8;
+    }
+    if (peer->rtt_samples < UINT16_MAX)
+    {
+        peer->rtt_samples++;
+    }
+}
+
+uint32_t ROKOR_Mesh::computeRtoMs(const PeerLink &peer)
+{
+    if (peer.rtt_samples == 0)
+        return DEFAULT_RTO_MS;
+    uint32_t rto_ms = (peer.srtt_us + 4 * peer.rttvar_us + 999) / 1000;
+    return std::min(MAX_RTO_MS, std::max(MIN_RTO_MS, rto_ms));
+}
+
+uint32_t ROKOR_Mesh::linkRtoMs(uint8_t peer_id)
+{
+    PeerLink *peer = findPeerLink(peer_id);
+    return peer ? computeRtoMs(*peer) : DEFAULT_RTO_MS;
+}
+
+ROKOR_Mesh::PeerLink *ROKOR_Mesh::findPeerLink(uint8_t peer_id)
+{
+    if (_current_role == ROLE_NODE)
+    {
+        return (peer_id == _gatewayPjonId) ? &_gateway_link : nullptr;
+    }
+    if (_current_role == ROLE_GATEWAY)
+    {
+        int node_idx = findNodeById(peer_id);
+        return (node_idx != -1) ? &_known_nodes[node_idx].link : nullptr;
+    }
+    return nullptr;
+}
+
+bool ROKOR_Mesh::streamSeqAvailable(uint8_t destinationId, const PeerLink &peer)
+{
+    // Неподтвержденные номера одному адресату не должны выходить за окно SACK получателя
+    for (uint8_t i = 0; i < ROKOR_MESH_TX_QUEUE_SIZE; ++i)
+    {
+        const TxSlot &slot = _tx_queue[i];
+        if (slot.state == TxSlotState::PENDING && slot.seq_assigned && slot.destination_id == destinationId &&
+            (uint16_t)(peer.tx_next_seq - slot.seq) > STREAM_SACK_BITS - MAX_STREAM_WINDOW)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ROKOR_Mesh::sendStreamBurst(const uint8_t *slot_indices, uint8_t count)
+{
+    for (uint8_t b = 0; b < count; ++b)
+    {
+        uint8_t slot_idx = slot_indices[b];
+        TxSlot &slot = _tx_queue[slot_idx];
+        PeerLink *peer = findPeerLink(slot.destination_id);
+        uint8_t target_mac[ESP_NOW_ETH_ALEN];
+        if (!peer || !resolveDestinationMac(slot.destination_id, target_mac))
+        {
+            completeTxSlot(slot_idx, TX_STATUS_FAIL);
+            continue;
+        }
+
+        if (slot.batch_open)
+        {
+            closeBatch(slot);
+        }
+        // Номер присваивается при первой передаче и не меняется при повторах: по нему сопоставляется STREAM_ACK
+        if (!slot.seq_assigned)
+        {
+            slot.seq = peer->tx_next_seq++;
+            slot.seq_assigned = true;
+        }
+
+        // STREAM_ACK запрашивается последним кадром пачки для каждого адресата
+        bool last_for_destination = true;
+        for (uint8_t n = b + 1; n < count; ++n)
+        {
+            if (_tx_queue[slot_indices[n]].destination_id == slot.destination_id)
+            {
+                last_for_destination = false;
+                break;
+            }
+        }
+
+        // Заголовок пишется в запас перед сообщением, сообщение не копируется
+        slot.frame[0] = (uint8_t)MeshDiscoveryMessage::DATA;
+        slot.frame[1] = last_for_destination ? STREAM_FLAG_ACK_REQUEST : 0;
+        slot.frame[2] = (uint8_t)(slot.seq & 0xFF);
+        slot.frame[3] = (uint8_t)(slot.seq >> 8);
+        selectPeer(target_mac);
+        _pjon_bus.set_receiver_id(slot.destination_id);
+        _pjon_bus.send_packet(slot.frame, DATA_HEADER_LEN + slot.length);
+
+        slot.attempts++;
+        slot.stream_in_flight = true;
+        slot.stream_sent_us = micros();
+    }
+}
+
+bool ROKOR_Mesh::acceptSequence(PeerLink &peer, uint16_t seq)
+{
+    // Скользящее окно из STREAM_SACK_BITS последних номеров: O(1) на кадр, 6 байт на соседа
+    uint16_t ahead = (uint16_t)(seq - peer.rx_highest_seq);
+    if (peer.rx_bitmap == 0)
+    {
+        peer.rx_highest_seq = seq;
+        peer.rx_bitmap = 1;
+        return true;
+    }
+    if (ahead != 0 && ahead < 0x8000)
+    {
+        peer.rx_bitmap = (ahead < STREAM_SACK_BITS) ? ((peer.rx_bitmap << ahead) | 1) : 1;
+        peer.rx_highest_seq = seq;
+        return true;
+    }
+
+    uint16_t behind = (uint16_t)(peer.rx_highest_seq - seq);
+    if (behind >= STREAM_SACK_BITS)
+    {
+        // Отправитель не держит неподтвержденными номера старше окна: это перезапуск его нумерации
+        peer.rx_highest_seq = seq;
+        peer.rx_bitmap = 1;
+        return true;
+    }
+    if (peer.rx_bitmap & (1UL << behind))
+    {
+        return false;
+    }
+    peer.rx_bitmap |= (1UL << behind);
+    return true;
+}
+
+void ROKOR_Mesh::handleData(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length)
+{
+    if (frame_length <= DATA_HEADER_LEN)
+        return;
+    uint8_t flags = frame[1];
+    uint16_t seq = (uint16_t)frame[2] | ((uint16_t)frame[3] << 8);
+
+    PeerLink *peer = findPeerLink(sender_id);
+    if (!peer)
+    {
+        // Отправитель не в таблице узлов (например, удален по неактивности): доставляем без проверки повторов
+        deliverUserPayload(sender_id, frame + DATA_HEADER_LEN, frame_length - DATA_HEADER_LEN);
+        return;
+    }
+
+    bool is_new = acceptSequence(*peer, seq);
+
+    // Подтверждение отправляется до доставки, чтобы долгий обработчик не вызывал повторов
+    if (flags & STREAM_FLAG_ACK_REQUEST)
+    {
+        sendStreamAck(sender_id, *peer);
+    }
+    if (is_new)
+    {
+        deliverUserPayload(sender_id, frame + DATA_HEADER_LEN, frame_length - DATA_HEADER_LEN);
+    }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    else
+    {
+        Serial.printf(F("[PJON RX] Duplicate DATA %u from ID %d dropped.\n"), seq, sender_id);
+    }
+#endif
+}
+
+void ROKOR_Mesh::sendStreamAck(uint8_t peer_id, const PeerLink &peer)
+{
+    uint8_t target_mac[ESP_NOW_ETH_ALEN];
+    if (!resolveDestinationMac(peer_id, target_mac))
+        return;
+    uint8_t payload[7];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::STREAM_ACK;
+    payload[1] = (uint8_t)(peer.rx_highest_seq & 0xFF);
+    payload[2] = (uint8_t)(peer.rx_highest_seq >> 8);
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        payload[3 + i] = (uint8_t)(peer.rx_bitmap >> (8 * i));
+    }
+    // Потерянный STREAM_ACK восполняется повтором кадра по таймауту
+    selectPeer(target_mac);
+    _pjon_bus.set_receiver_id(peer_id);
+    _pjon_bus.send_packet(payload, sizeof(payload));
+}
+
+void ROKOR_Mesh::handleStreamAck(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length)
+{
+    if (frame_length < 7)
+        return;
+    uint16_t highest = (uint16_t)frame[1] | ((uint16_t)frame[2] << 8);
+    uint32_t bitmap = (uint32_t)frame[3] | ((uint32_t)frame[4] << 8) | ((uint32_t)frame[5] << 16) | ((uint32_t)frame[6] << 24);
+    uint32_t current_time = millis();
+
+    for (uint8_t i = 0; i < ROKOR_MESH_TX_QUEUE_SIZE; ++i)
+    {
+        TxSlot &slot = _tx_queue[i];
+        if (slot.state != TxSlotState::PENDING || !slot.seq_assigned || slot.destination_id != sender_id)
+            continue;
+        uint16_t behind = (uint16_t)(highest - slot.seq);
+        if (behind >= 0x8000)
+            continue; // Кадр новее подтвержденных: ответ на него еще впереди
+        if (behind < STREAM_SACK_BITS && (bitmap & (1UL << behind)))
+        {
+            // STREAM_ACK отвечает на кадр с номером highest; повторно отправленные кадры не измеряются (алгоритм Карна)
+            if (behind == 0 && slot.stream_in_flight && slot.attempts == 1)
+            {
+                addRttSample(sender_id, micros() - slot.stream_sent_us);
+            }
+            // Опоздавший STREAM_ACK тоже засчитывается: получатель принял одну из передач кадра
+            completeTxSlot(i, TX_STATUS_ACK);
+        }
+        else if (slot.stream_in_flight)
+        {
+            // Получатель принял более поздний кадр, а этот нет: ESP-NOW не меняет порядок, кадр потерян
+            slot.stream_in_flight = false;
+            slot.next_attempt_time = current_time;
+        }
+    }
+}
+
+// --- Групповая рассылка (шлюз) ---
+ROKOR_Mesh_TxHandle ROKOR_Mesh::sendToMany(const uint8_t *ids, uint8_t count, const uint8_t *payload, uint16_t length, bool requestAck)
+{
+    return sendToMany(ids, count, ROKOR_MESH_DEFAULT_MESSAGE_TYPE, payload, length, requestAck);
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::sendToMany(const uint8_t *ids, uint8_t count, uint8_t messageType, const uint8_t *payload, uint16_t length, bool requestAck)
+{
+    if (!ids || count == 0)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendToMany: Empty destination list."));
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    uint8_t id_bitmap[NODE_ID_BITMAP_BYTES] = {0};
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (ids[i] != PJON_BROADCAST_ADDRESS && ids[i] != PJON_NOT_ASSIGNED)
+        {
+            id_bitmap[ids[i] >> 3] |= (uint8_t)(1 << (ids[i] & 7));
+        }
+    }
+    return sendMulticast(id_bitmap, messageType, payload, length, requestAck);
+}
+
+bool ROKOR_Mesh::setNodeGroup(uint8_t groupId, const uint8_t *ids, uint8_t count)
+{
+    if (groupId >= ROKOR_MESH_MAX_NODE_GROUPS || (count > 0 && !ids))
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] setNodeGroup: Invalid group %d.\n"), groupId);
+#endif
+        return false;
+    }
+    memset(_node_groups[groupId], 0, NODE_ID_BITMAP_BYTES);
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (ids[i] != PJON_BROADCAST_ADDRESS && ids[i] != PJON_NOT_ASSIGNED)
+        {
+            _node_groups[groupId][ids[i] >> 3] |= (uint8_t)(1 << (ids[i] & 7));
+        }
+    }
+    return true;
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::sendToGroup(uint8_t groupId, const uint8_t *payload, uint16_t length, bool requestAck)
+{
+    return sendToGroup(groupId, ROKOR_MESH_DEFAULT_MESSAGE_TYPE, payload, length, requestAck);
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::sendToGroup(uint8_t groupId, uint8_t messageType, const uint8_t *payload, uint16_t length, bool requestAck)
+{
+    if (groupId >= ROKOR_MESH_MAX_NODE_GROUPS)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[ROKOR_Mesh] sendToGroup: Invalid group %d.\n"), groupId);
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    return sendMulticast(_node_groups[groupId], messageType, payload, length, requestAck);
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::sendMulticast(const uint8_t *id_bitmap, uint8_t message_type, const uint8_t *payload, uint16_t length, bool requestAck)
+{
+    if (_current_role != ROLE_GATEWAY)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendToMany: Only gateway can multicast."));
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+
+    // Передаем только байты карты от первого до последнего адресата
+    int first_byte = -1;
+    int last_byte = -1;
+    for (int i = 0; i < NODE_ID_BITMAP_BYTES; ++i)
+    {
+        if (id_bitmap[i] != 0)
+        {
+            if (first_byte == -1)
+                first_byte = i;
+            last_byte = i;
+        }
+    }
+    if (first_byte == -1 || !payload)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendToMany: No destinations or empty payload."));
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    uint8_t bitmap_len = last_byte - first_byte + 1;
+    MulticastTrack *track = nullptr;
+    if (requestAck)
+    {
+        track = findMulticastTrack(ROKOR_MESH_INVALID_TX_HANDLE);
+        if (!track)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.println(F("[ROKOR_Mesh] sendToMany: Too many multicasts awaiting ACK."));
+#endif
+            return ROKOR_MESH_INVALID_TX_HANDLE;
+        }
+    }
+    uint16_t app_offset = MULTICAST_HEADER_LEN + bitmap_len;
+    uint16_t frame_length = app_offset + APP_HEADER_LEN + length;
+    if (length == 0 || !validateOutgoing(PJON_BROADCAST_ADDRESS, frame_length, TX_FRAME_SIZE))
+    {
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+
+    int slot_idx = reserveTxSlot(PJON_BROADCAST_ADDRESS);
+    if (slot_idx == -1)
+    {
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    TxSlot &slot = _tx_queue[slot_idx];
+    ROKOR_Mesh_TxHandle handle = slot.handle;
+    uint8_t seq = _multicast_seq++;
+    slot.data[0] = (uint8_t)MeshDiscoveryMessage::MULTICAST;
+    slot.data[1] = requestAck ? MULTICAST_FLAG_ACK_REQUESTED : 0;
+    slot.data[2] = seq;
+    slot.data[3] = (uint8_t)(first_byte * 8);
+    slot.data[4] = bitmap_len;
+    memcpy(&slot.data[MULTICAST_HEADER_LEN], &id_bitmap[first_byte], bitmap_len);
+    slot.data[app_offset] = (uint8_t)MeshDiscoveryMessage::APP_MESSAGE;
+    slot.data[app_offset + 1] = message_type;
+    memcpy(&slot.data[app_offset + APP_HEADER_LEN], payload, length);
+    commitTxSlot(slot_idx, frame_length);
+
+    if (track)
+    {
+        // Ждем ответа только от зарегистрированных адресатов: незнакомый ID не ответит никогда
+        memset(track, 0, sizeof(*track));
+        track->handle = handle;
+        track->seq = seq;
+        uint16_t group_size = 0; // Узлы берут окно задержки по всей карте, шлюз ждет столько же
+        for (uint16_t id = 0; id < NODE_ID_BITMAP_BYTES * 8; ++id)
+        {
+            if (!(id_bitmap[id >> 3] & (1 << (id & 7))))
+                continue;
+            group_size++;
+            if (findNodeById(id) != -1)
+            {
+                track->waiting[id >> 3] |= (uint8_t)(1 << (id & 7));
+                track->expected++;
+            }
+        }
+        track->deadline_ms = MULTICAST_ACK_SLOT_MS * group_size + MULTICAST_ACK_MARGIN_MS;
+    }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[GW] MULTICAST seq %d queued (bitmap %d bytes, payload %d bytes).\n"), seq, bitmap_len, length);
+#endif
+    return handle;
+}
+
+void ROKOR_Mesh::handleMulticast(const PJON_Packet_Info &packet_info, const uint8_t *frame, uint16_t frame_length)
+{
+    if (frame_length < MULTICAST_HEADER_LEN)
+        return;
+    uint8_t flags = frame[1];
+    uint8_t seq = frame[2];
+    uint8_t first_id = frame[3];
+    uint8_t bitmap_len = frame[4];
+    if (MULTICAST_HEADER_LEN + bitmap_len >= frame_length)
+        return;
+
+    // Узел фильтрует кадр по своему биту в карте адресатов
+    if (_myPjonId < first_id || _myPjonId >= first_id + bitmap_len * 8)
+        return;
+    uint8_t bit_index = _myPjonId - first_id;
+    if ((frame[MULTICAST_HEADER_LEN + (bit_index >> 3)] & (1 << (bit_index & 7))) == 0)
+        return;
+
+    deliverUserPayload(packet_info.sender_id, frame + MULTICAST_HEADER_LEN + bitmap_len, frame_length - MULTICAST_HEADER_LEN - bitmap_len);
+
+    if (flags & MULTICAST_FLAG_ACK_REQUESTED)
+    {
+        // Случайная задержка в окне, пропорциональном числу адресатов: ответы группы не сталкиваются
+        uint16_t group_size = 0;
+        for (uint8_t i = 0; i < bitmap_len; ++i)
+        {
+            group_size += __builtin_popcount(frame[MULTICAST_HEADER_LEN + i]);
+        }
+        if (_multicast_ack_pending)
+        {
+            sendMulticastAck(); // Ответ на предыдущую рассылку не откладывается дальше
+        }
+        _multicast_ack_pending = true;
+        _multicast_ack_seq = seq;
+        _multicast_ack_due = millis() + esp_random() % (MULTICAST_ACK_SLOT_MS * group_size + 1);
+    }
+}
+
+void ROKOR_Mesh::sendMulticastAck()
+{
+    _multicast_ack_pending = false;
+    if (_current_role != ROLE_NODE || _gatewayPjonId == PJON_NOT_ASSIGNED)
+        return;
+    uint8_t ack_payload[] = {(uint8_t)MeshDiscoveryMessage::MULTICAST_ACK, _multicast_ack_seq};
+    selectPeer(_gateway_mac_addr);
+    _pjon_bus.set_receiver_id(_gatewayPjonId);
+    _pjon_bus.send(ack_payload, sizeof(ack_payload));
+}
+
+void ROKOR_Mesh::handleMulticastAck(uint8_t node_id, uint8_t seq)
+{
+    uint32_t current_time = millis();
+    for (uint8_t i = 0; i < MULTICAST_TRACK_SIZE; ++i)
+    {
+        MulticastTrack &track = _multicast_track[i];
+        if (track.handle == ROKOR_MESH_INVALID_TX_HANDLE || !track.sent || track.seq != seq ||
+            current_time - track.sent_time > track.deadline_ms)
+            continue;
+        uint8_t mask = (uint8_t)(1 << (node_id & 7));
+        if (!(track.waiting[node_id >> 3] & mask))
+            continue; // Не адресат этой рассылки или повтор ответа
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[GW RX] MULTICAST_ACK seq %d from Node ID %d.\n"), seq, node_id);
+#endif
+        track.waiting[node_id >> 3] &= (uint8_t)~mask;
+        track.acked++;
+        notifyMulticastAck(track.handle, node_id);
+        if (track.acked == track.expected)
+        {
+            finishMulticastTrack(track);
+        }
+        return;
+    }
+}
+
+ROKOR_Mesh::MulticastTrack *ROKOR_Mesh::findMulticastTrack(ROKOR_Mesh_TxHandle handle)
+{
+    for (uint8_t i = 0; i < MULTICAST_TRACK_SIZE; ++i)
+    {
+        if (_multicast_track[i].handle == handle)
+            return &_multicast_track[i];
+    }
+    return nullptr;
+}
+
+bool ROKOR_Mesh::startMulticastTrack(ROKOR_Mesh_TxHandle handle)
+{
+    MulticastTrack *track = findMulticastTrack(handle);
+    if (!track || track->expected == 0)
+    {
+        if (track)
+            track->handle = ROKOR_MESH_INVALID_TX_HANDLE;
+        return false;
+    }
+    // Окно ответов отсчитывается от выхода кадра в эфир, а не от постановки в очередь
+    track->sent = true;
+    track->sent_time = millis();
+    return true;
+}
+
+void ROKOR_Mesh::finishMulticastTrack(MulticastTrack &track)
+{
+    ROKOR_Mesh_TxStatus status = (track.acked == track.expected) ? TX_STATUS_ACK : (track.acked > 0) ? TX_STATUS_PARTIAL
+                                                                                                       : TX_STATUS_FAIL;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[GW] MULTICAST seq %d: %d of %d nodes acknowledged.\n"), track.seq, track.acked, track.expected);
+#endif
+    ROKOR_Mesh_TxHandle handle = track.handle;
+    track.handle = ROKOR_MESH_INVALID_TX_HANDLE;
+    notifyTxComplete(handle, PJON_BROADCAST_ADDRESS, status);
+}
+
+void ROKOR_Mesh::processMulticastAcks()
+{
+    uint32_t current_time = millis();
+    if (_multicast_ack_pending && (int32_t)(current_time - _multicast_ack_due) >= 0)
+    {
+        sendMulticastAck();
+    }
+    for (uint8_t i = 0; i < MULTICAST_TRACK_SIZE; ++i)
+    {
+        MulticastTrack &track = _multicast_track[i];
+        if (track.handle != ROKOR_MESH_INVALID_TX_HANDLE && track.sent && current_time - track.sent_time > track.deadline_ms)
+        {
+            finishMulticastTrack(track);
+        }
+    }
+}
+
+// --- Фрагментация ---
+void ROKOR_Mesh::initFragmentation()
+{
+    _fragment_tx.active = false;
+    _fragment_tx.awaiting_status = false;
+    _fragment_tx.handle = ROKOR_MESH_INVALID_TX_HANDLE;
+    for (uint8_t i = 0; i < ROKOR_MESH_REASSEMBLY_SLOTS; ++i)
+    {
+        _reassembly[i].state = ReassemblyState::FREE;
+    }
+}
+
+ROKOR_Mesh_TxHandle ROKOR_Mesh::startFragmentedTx(uint8_t destinationId, uint8_t message_type, const uint8_t *payload, uint16_t length)
+{
+    if (destinationId == PJON_BROADCAST_ADDRESS)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendMessage: Fragmented messages cannot be broadcast."));
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    if (!validateOutgoing(destinationId, length, ROKOR_MESH_MAX_MESSAGE_SIZE))
+    {
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+    if (_fragment_tx.active)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] sendMessage: Another fragmented message is in progress."));
+#endif
+        return ROKOR_MESH_INVALID_TX_HANDLE;
+    }
+
+    FragmentTx &tx = _fragment_tx;
+    portENTER_CRITICAL_SAFE(&_tx_queue_mux);
+    tx.handle = _tx_next_handle++;
+    if (_tx_next_handle == ROKOR_MESH_INVALID_TX_HANDLE)
+    {
+        _tx_next_handle = 1;
+    }
+    portEXIT_CRITICAL_SAFE(&_tx_queue_mux);
+
+    tx.destination_id = destinationId;
+    tx.msg_id = _fragment_next_msg_id++;
+    tx.length = APP_HEADER_LEN + length;
+    tx.frag_count = (tx.length + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+    tx.acked_count = 0;
+    tx.stalled_rounds = 0;
+    tx.awaiting_status = false;
+    tx.start_time = millis();
+    tx.timeout_ms = _tx_timeout_ms + tx.frag_count * FRAGMENT_TIMEOUT_PER_FRAGMENT_MS;
+    memset(tx.acked, 0, sizeof(tx.acked));
+    memset(tx.in_flight, 0, sizeof(tx.in_flight));
+    tx.data[0] = (uint8_t)MeshDiscoveryMessage::APP_MESSAGE;
+    tx.data[1] = message_type;
+    memcpy(&tx.data[APP_HEADER_LEN], payload, length);
+    tx.active = true;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[ROKOR_Mesh] Fragmenting %d bytes to ID %d into %d fragments (msg %d).\n"), length, destinationId, tx.frag_count, tx.msg_id);
+#endif
+    signalActivity();
+    return tx.handle;
+}
+
+void ROKOR_Mesh::processFragmentTx()
+{
+    FragmentTx &tx = _fragment_tx;
+    if (!tx.active || !_pjon_bus.is_listening())
+        return;
+
+    uint32_t current_time = millis();
+    if (current_time - tx.start_time >= tx.timeout_ms)
+    {
+        completeFragmentTx(TX_STATUS_TIMEOUT);
+        return;
+    }
+    if (tx.awaiting_status)
+    {
+        if (micros() - tx.status_wait_start_us < linkRtoMs(tx.destination_id) * 1000UL * (tx.stalled_rounds + 1))
+            return;
+        // FRAGMENT_STATUS не пришел: неподтвержденные фрагменты окна отправляются повторно
+        memset(tx.in_flight, 0, sizeof(tx.in_flight));
+        tx.awaiting_status = false;
+        if (++tx.stalled_rounds >= FRAGMENT_MAX_STALLED_ROUNDS)
+        {
+            completeFragmentTx(TX_STATUS_FAIL);
+            return;
+        }
+    }
+
+    uint8_t target_mac[ESP_NOW_ETH_ALEN];
+    if (!resolveDestinationMac(tx.destination_id, target_mac))
+    {
+        completeFragmentTx(TX_STATUS_FAIL);
+        return;
+    }
+
+    uint8_t window[MAX_FRAGMENT_WINDOW];
+    uint8_t window_count = 0;
+    for (uint8_t i = 0; i < tx.frag_count && window_count < _fragment_window; ++i)
+    {
+        uint8_t mask = 1 << (i & 7);
+        if (!(tx.acked[i >> 3] & mask) && !(tx.in_flight[i >> 3] & mask))
+        {
+            window[window_count++] = i;
+        }
+    }
+    if (window_count == 0)
+        return;
+
+    // Получатель отвечает одним FRAGMENT_STATUS на окно
+    uint8_t frame[ROKOR_MESH_MAX_PAYLOAD_SIZE];
+    selectPeer(target_mac);
+    _pjon_bus.set_receiver_id(tx.destination_id);
+    for (uint8_t w = 0; w < window_count; ++w)
+    {
+        uint8_t index = window[w];
+        uint16_t offset = (uint16_t)index * FRAGMENT_DATA_SIZE;
+        uint16_t data_length = std::min((uint16_t)(tx.length - offset), (uint16_t)FRAGMENT_DATA_SIZE);
+        frame[0] = (uint8_t)MeshDiscoveryMessage::FRAGMENT;
+        frame[1] = tx.msg_id;
+        frame[2] = index;
+        frame[3] = tx.frag_count;
+        frame[4] = (w == window_count - 1) ? FRAGMENT_FLAG_STATUS_REQUEST : 0;
+        memcpy(&frame[FRAGMENT_HEADER_LEN], &tx.data[offset], data_length);
+        _pjon_bus.send_packet(frame, FRAGMENT_HEADER_LEN + data_length);
+        tx.in_flight[index >> 3] |= (uint8_t)(1 << (index & 7));
+    }
+
+    tx.awaiting_status = true;
+    tx.status_wait_start_us = micros();
+}
+
+void ROKOR_Mesh::completeFragmentTx(ROKOR_Mesh_TxStatus status)
+{
+    _fragment_tx.active = false;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[ROKOR_Mesh] Fragmented msg %d to ID %d finished with status %d (%d/%d acked).\n"),
+                  _fragment_tx.msg_id, _fragment_tx.destination_id, status, _fragment_tx.acked_count, _fragment_tx.frag_count);
+#endif
+    notifyTxComplete(_fragment_tx.handle, _fragment_tx.destination_id, status);
+}
+
+void ROKOR_Mesh::handleFragmentStatus(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length)
+{
+    FragmentTx &tx = _fragment_tx;
+    if (frame_length < 3 || !tx.active || sender_id != tx.destination_id || frame[1] != tx.msg_id)
+        return;
+    uint8_t bitmap_len = std::min((uint8_t)frame[2], (uint8_t)FRAGMENT_BITMAP_BYTES);
+    if (3 + bitmap_len > frame_length)
+        return;
+
+    bool progress = false;
+    for (uint8_t i = 0; i < tx.frag_count; ++i)
+    {
+        uint8_t mask = 1 << (i & 7);
+        if ((i >> 3) < bitmap_len && (frame[3 + (i >> 3)] & mask) && !(tx.acked[i >> 3] & mask))
+        {
+            tx.acked[i >> 3] |= mask;
+            tx.acked_count++;
+            progress = true;
+        }
+    }
+    if (progress)
+    {
+        tx.stalled_rounds = 0;
+    }
+    else
+    {
+        tx.stalled_rounds++;
+    }
+    if (tx.awaiting_status)
+    {
+        addRttSample(sender_id, micros() - tx.status_wait_start_us);
+    }
+    memset(tx.in_flight, 0, sizeof(tx.in_flight));
+    tx.awaiting_status = false;
+
+    if (tx.acked_count >= tx.frag_count)
+    {
+        completeFragmentTx(TX_STATUS_ACK);
+    }
+    else if (tx.stalled_rounds >= FRAGMENT_MAX_STALLED_ROUNDS)
+    {
+        completeFragmentTx(TX_STATUS_FAIL);
+    }
+}
+
+void ROKOR_Mesh::handleFragment(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length)
+{
+    if (frame_length <= FRAGMENT_HEADER_LEN)
+        return;
+    uint8_t msg_id = frame[1];
+    uint8_t index = frame[2];
+    uint8_t frag_count = frame[3];
+    uint8_t flags = frame[4];
+    const uint8_t *data = frame + FRAGMENT_HEADER_LEN;
+    uint16_t data_length = frame_length - FRAGMENT_HEADER_LEN;
+
+    // FRAGMENT_MAX_COUNT округлен вверх, поэтому последний фрагмент проверяется по размеру буфера сборки
+    if (frag_count == 0 || frag_count > FRAGMENT_MAX_COUNT || index >= frag_count || data_length > FRAGMENT_DATA_SIZE ||
+        (index < frag_count - 1 && data_length != FRAGMENT_DATA_SIZE) ||
+        (uint32_t)index * FRAGMENT_DATA_SIZE + data_length > FRAGMENT_MESSAGE_SIZE)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[PJON RX] Invalid FRAGMENT %d/%d from ID %d. Dropping.\n"), index, frag_count, sender_id);
+#endif
+        return;
+    }
+
+    ReassemblySlot *slot = nullptr;
+    for (uint8_t i = 0; i < ROKOR_MESH_REASSEMBLY_SLOTS; ++i)
+    {
+        ReassemblySlot &candidate = _reassembly[i];
+        if (candidate.state == ReassemblyState::FREE || candidate.sender_id != sender_id ||
+            candidate.msg_id != msg_id || candidate.frag_count != frag_count)
+            continue;
+        // Завершенная давно сборка не мешает новому сообщению с тем же (повторно использованным) msg_id
+        if (candidate.state == ReassemblyState::COMPLETE && millis() - candidate.last_activity > REASSEMBLY_TIMEOUT_MS)
+        {
+            candidate.state = ReassemblyState::FREE;
+            continue;
+        }
+        slot = &candidate;
+        break;
+    }
+    if (!slot)
+    {
+        slot = allocateReassembly(sender_id, msg_id, frag_count);
+        if (!slot)
+        {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+            Serial.printf(F("[PJON RX] No reassembly slot for msg %d from ID %d. Dropping fragment.\n"), msg_id, sender_id);
+#endif
+            return;
+        }
+    }
+    slot->last_activity = millis();
+
+    if (slot->state == ReassemblyState::COMPLETE)
+    {
+        // Подтверждение уже доставленного сообщения потерялось: повторяем его
+        sendFragmentStatus(*slot);
+        return;
+    }
+
+    uint8_t mask = 1 << (index & 7);
+    if (!(slot->received[index >> 3] & mask))
+    {
+        memcpy(&slot->data[(uint16_t)index * FRAGMENT_DATA_SIZE], data, data_length);
+        slot->received[index >> 3] |= mask;
+        slot->received_count++;
+        if (index == frag_count - 1)
+        {
+            slot->length = (uint16_t)index * FRAGMENT_DATA_SIZE + data_length;
+        }
+    }
+
+    if (slot->received_count == slot->frag_count)
+    {
+        slot->state = ReassemblyState::COMPLETE;
+        sendFragmentStatus(*slot);
+        deliverUserPayload(sender_id, slot->data, slot->length);
+    }
+    else if (flags & FRAGMENT_FLAG_STATUS_REQUEST)
+    {
+        sendFragmentStatus(*slot);
+    }
+}
+
+ROKOR_Mesh::ReassemblySlot *ROKOR_Mesh::allocateReassembly(uint8_t sender_id, uint8_t msg_id, uint8_t frag_count)
+{
+    uint32_t current_time = millis();
+    ReassemblySlot *candidate = nullptr;
+    ReassemblySlot *oldest_own = nullptr;
+    uint8_t own_active = 0;
+
+    for (uint8_t i = 0; i < ROKOR_MESH_REASSEMBLY_SLOTS; ++i)
+    {
+        ReassemblySlot &slot = _reassembly[i];
+        if (slot.state == ReassemblyState::ACTIVE && slot.sender_id == sender_id)
+        {
+            own_active++;
+            if (!oldest_own || (int32_t)(slot.last_activity - oldest_own->last_activity) < 0)
+                oldest_own = &slot;
+        }
+        // Свободный слот лучше завершенного, завершенный лучше устаревшей сборки
+        if (slot.state == ReassemblyState::FREE)
+        {
+            if (!candidate || candidate->state != ReassemblyState::FREE)
+                candidate = &slot;
+        }
+        else if (slot.state == ReassemblyState::COMPLETE || current_time - slot.last_activity > REASSEMBLY_TIMEOUT_MS)
+        {
+            if (!candidate)
+                candidate = &slot;
+        }
+    }
+    // Новое сообщение от отправителя, исчерпавшего лимит, вытесняет его самую старую сборку
+    if (own_active >= ROKOR_MESH_REASSEMBLY_PER_SENDER)
+    {
+        candidate = oldest_own;
+    }
+    if (!candidate)
+        return nullptr;
+
+    candidate->state = ReassemblyState::ACTIVE;
+    candidate->sender_id = sender_id;
+    candidate->msg_id = msg_id;
+    candidate->frag_count = frag_count;
+    candidate->received_count = 0;
+    candidate->length = 0;
+    candidate->last_activity = current_time;
+    memset(candidate->received, 0, sizeof(candidate->received));
+    return candidate;
+}
+
+void ROKOR_Mesh::sendFragmentStatus(const ReassemblySlot &slot)
+{
+    uint8_t target_mac[ESP_NOW_ETH_ALEN];
+    if (!resolveDestinationMac(slot.sender_id, target_mac))
+        return;
+    uint8_t bitmap_len = (slot.frag_count + 7) / 8;
+    uint8_t payload[3 + FRAGMENT_BITMAP_BYTES];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::FRAGMENT_STATUS;
+    payload[1] = slot.msg_id;
+    payload[2] = bitmap_len;
+    memcpy(&payload[3], slot.received, bitmap_len);
+    selectPeer(target_mac);
+    _pjon_bus.set_receiver_id(slot.sender_id);
+    _pjon_bus.send(payload, 3 + bitmap_len);
+}
+
+// --- Служебные сообщения ---
+void ROKOR_Mesh::sendGatewayAnnounce(const uint8_t *target_mac)
+{
+    uint8_t payload[1 + ESP_NOW_ETH_ALEN + 2];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::GATEWAY_ANNOUNCE;
+    memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
+    payload[1 + ESP_NOW_ETH_ALEN] = _gateway_priority; // Для сравнения, если в сети окажется второй шлюз
+    payload[2 + ESP_NOW_ETH_ALEN] = ROKOR_MESH_PROTOCOL_VERSION;
+
+    // Ответ на GATEWAY_SOLICIT идет на MAC узла; ID у узла еще нет, поэтому получатель PJON - broadcast
+    selectPeer(target_mac ? target_mac : _esp_now_broadcast_mac);
+    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
+    _pjon_bus.send(payload, sizeof(payload));
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[GW] Sent GATEWAY_ANNOUNCE%s. My ID: %d\n"), target_mac ? " (solicited)" : "", _myPjonId);
+#endif
+}
+
+void ROKOR_Mesh::startAnnounceTrickle()
+{
+    _announce_trickle_interval_ms = ANNOUNCE_TRICKLE_MIN_INTERVAL_MS;
+    _next_gateway_announce_time = millis(); // Первое объявление - сразу
+}
+
+void ROKOR_Mesh::resetAnnounceTrickle()
+{
+    // Интервал уже минимальный - объявление и так скоро; иначе поток событий откладывал бы его
+    if (_announce_trickle_interval_ms == ANNOUNCE_TRICKLE_MIN_INTERVAL_MS)
+        return;
+    _announce_trickle_interval_ms = ANNOUNCE_TRICKLE_MIN_INTERVAL_MS;
+    scheduleGatewayAnnounce();
+}
+
+void ROKOR_Mesh::scheduleGatewayAnnounce()
+{
+    // Момент во второй половине интервала: соседние шлюзы не передают синхронно
+    uint32_t half = _announce_trickle_interval_ms / 2;
+    _next_gateway_announce_time = millis() + half + esp_random() % half;
+}
+
+void ROKOR_Mesh::sendGatewayClaim()
+{
+    uint8_t payload[1 + ESP_NOW_ETH_ALEN + 2];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::GATEWAY_CLAIM;
+    memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
+    payload[1 + ESP_NOW_ETH_ALEN] = _gateway_priority;
+    payload[2 + ESP_NOW_ETH_ALEN] = ROKOR_MESH_PROTOCOL_VERSION;
+
+    selectPeer(_esp_now_broadcast_mac);
+    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
+    _pjon_bus.send(payload, sizeof(payload));
+    // Случайная добавка разносит заявки кандидатов, стартовавших одновременно
+    _next_claim_time = millis() + ELECTION_CLAIM_INTERVAL_MS + esp_random() % ELECTION_CLAIM_JITTER_MS;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[FSM] Sent GATEWAY_CLAIM (priority %d).\n"), _gateway_priority);
+#endif
+}
+
+bool ROKOR_Mesh::outranksMe(uint8_t priority, const uint8_t mac[6]) const
+{
+    if (priority != _gateway_priority)
+        return priority > _gateway_priority;
+    return memcmp(mac, _my_mac_addr, ESP_NOW_ETH_ALEN) < 0;
+}
+
+void ROKOR_Mesh::stepDownToNode(uint8_t gateway_id, const uint8_t gateway_mac[6])
+{
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[GW] Outranked by gateway %02X:%02X:%02X:%02X:%02X:%02X. Stepping down to node.\n"),
+                  gateway_mac[0], gateway_mac[1], gateway_mac[2], gateway_mac[3], gateway_mac[4], gateway_mac[5]);
+#endif
+    for (uint8_t i = 0; i < ROKOR_MESH_MAX_NODES; ++i)
+    {
+        if (_known_nodes[i].pjon_id != PJON_NOT_ASSIGNED)
+        {
+            notifyNodeStatus(_known_nodes[i].pjon_id, false);
+        }
+    }
+    initNodeManagement();
+
+    _current_role = ROLE_DISCOVERING;
+    _myPjonId = PJON_NOT_ASSIGNED;
+    _gatewayPjonId = gateway_id;
+    memcpy(_gateway_mac_addr, gateway_mac, ESP_NOW_ETH_ALEN);
+    _pjon_bus.end();
+    initializePjonStack(PJON_NOT_ASSIGNED, _pjon_bus_id, false);
+    if (_standby_enabled)
+    {
+        enterStandby();
+        return;
+    }
+    _fsm_state = DiscoveryFSM::REQUEST_NODE_ID;
+    _fsm_timer_start = millis();
+    _node_id_retry_window_ms = NODE_ID_RETRY_MIN_MS;
+    sendNodeIdRequest();
+}
+
+void ROKOR_Mesh::sendLivenessBeacon()
+{
+    uint8_t payload[5 + NODE_ID_WORDS * 4];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::LIVENESS_BEACON;
+    payload[1] = ++_liveness_beacon_seq;
+    payload[2] = (uint8_t)(_liveness_beacon_interval_ms & 0xFF);
+    payload[3] = (uint8_t)(_liveness_beacon_interval_ms >> 8);
+    // Карта зарегистрированных ID (узлы таблицы, еще не удаленные по сроку); хвост из нулевых байт не передается
+    uint8_t bitmap_len = 0;
+    for (uint8_t b = 0; b < NODE_ID_WORDS * 4; ++b)
+    {
+        payload[5 + b] = (uint8_t)(_node_id_registered[b >> 2] >> ((b & 3) * 8));
+        if (payload[5 + b])
+            bitmap_len = b + 1;
+    }
+    payload[4] = bitmap_len;
+
+    selectPeer(_esp_now_broadcast_mac);
+    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
+    _pjon_bus.send(payload, 5 + bitmap_len);
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[GW] Sent LIVENESS_BEACON #%d (%d nodes).\n"), _liveness_beacon_seq, _known_nodes_count);
+#endif
+}
+
+void ROKOR_Mesh::sendGatewaySolicit()
+{
+    uint8_t payload[1 + ESP_NOW_ETH_ALEN];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::GATEWAY_SOLICIT;
+    memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
+
+    selectPeer(_esp_now_broadcast_mac);
+    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
+    _pjon_bus.send(payload, sizeof(payload));
+    _next_solicit_time = millis() + GATEWAY_SOLICIT_INTERVAL_MS + esp_random() % GATEWAY_SOLICIT_JITTER_MS;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.println(F("[Node] Sent GATEWAY_SOLICIT."));
+#endif
+}
+
+void ROKOR_Mesh::queueSolicitReply(const uint8_t mac[6])
+{
+    SolicitReply *free_slot = nullptr;
+    for (uint8_t i = 0; i < SOLICIT_REPLY_SLOTS; ++i)
+    {
+        SolicitReply &reply = _solicit_replies[i];
+        if (!reply.pending)
+        {
+            if (!free_slot)
+                free_slot = &reply;
+        }
+        else if (memcmp(reply.mac, mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return; // Повторный запрос до ответа
+        }
+    }
+    if (!free_slot)
+        return; // Узел повторит запрос
+    memcpy(free_slot->mac, mac, ESP_NOW_ETH_ALEN);
+    // Случайная задержка разносит ответы нескольких шлюзов и на запросы нескольких узлов
+    free_slot->due_time = millis() + esp_random() % SOLICIT_REPLY_JITTER_MS;
+    free_slot->pending = true;
+}
+
+void ROKOR_Mesh::processSolicitReplies()
+{
+    uint32_t current_time = millis();
+    for (uint8_t i = 0; i < SOLICIT_REPLY_SLOTS; ++i)
+    {
+        SolicitReply &reply = _solicit_replies[i];
+        if (reply.pending && (int32_t)(current_time - reply.due_time) >= 0)
+        {
+            reply.pending = false;
+            sendGatewayAnnounce(reply.mac);
+        }
+    }
+}
+
+// --- Резервный шлюз ---
+void ROKOR_Mesh::setStandbyGateway(bool enabled)
+{
+    if (_is_begun)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[ROKOR_Mesh] Error: Cannot change standby mode after begin(). Call end() first."));
+#endif
+        return;
+    }
+    _standby_enabled = enabled;
+}
+
+void ROKOR_Mesh::queueStandbyChange(uint8_t node_id, const uint8_t *mac)
+{
+    if (_current_role != ROLE_GATEWAY || !_standby_present)
+        return;
+    if (_standby_pending_count >= STANDBY_SYNC_MAX_RECORDS)
+    {
+        // Изменений больше, чем вмещает кадр: резерв получит их в новом снимке
+        _standby_snapshot_cursor = 0;
+        _standby_pending_count = 0;
+        return;
+    }
+    uint8_t *record = &_standby_pending[_standby_pending_count++ * LEASE_RECORD_LEN];
+    record[0] = node_id;
+    if (mac)
+        memcpy(&record[1], mac, ESP_NOW_ETH_ALEN);
+    else
+        memset(&record[1], 0, ESP_NOW_ETH_ALEN);
+}
+
+void ROKOR_Mesh::handleStandbyHello(const uint8_t *payload, uint16_t length)
+{
+    if (length < ESP_NOW_ETH_ALEN + 2)
+        return;
+    const uint8_t *mac = payload;
+    bool synced = payload[ESP_NOW_ETH_ALEN] != 0;
+    uint8_t seq = payload[ESP_NOW_ETH_ALEN + 1];
+    uint32_t current_time = millis();
+
+    bool known = _standby_present && memcmp(mac, _standby_mac, ESP_NOW_ETH_ALEN) == 0;
+    if (!known)
+    {
+        // Резерв один; второй принимается, только если первый пропал
+        if (_standby_present && current_time - _standby_last_heard <= STANDBY_LEASE_MS)
+            return;
+        if (_standby_present)
+            releasePeer(_standby_mac);
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[GW RX] STANDBY_HELLO: new standby gateway %02X:%02X:%02X:%02X:%02X:%02X\n"),
+                      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#endif
+        memcpy(_standby_mac, mac, ESP_NOW_ETH_ALEN);
+        _standby_present = true;
+        _standby_snapshot_cursor = 0;
+        _standby_pending_count = 0;
+    }
+    _standby_last_heard = current_time;
+    if (length >= ESP_NOW_ETH_ALEN + 3 && (payload[ESP_NOW_ETH_ALEN + 2] & STANDBY_HELLO_FLAG_PROBE))
+    {
+        // Резерв не слышит пульс и проверяет шлюз перед заменой: пульс уходит в ближайшем processStandbySync()
+        _standby_last_sync_sent = current_time - STANDBY_HEARTBEAT_MS;
+    }
+    // Снимок, который уже передается, не перезапускается: резерв ждет его окончания
+    if ((!synced || seq != _standby_tx_seq) && _standby_snapshot_cursor == NODE_SLOT_NONE)
+    {
+        _standby_snapshot_cursor = 0;
+        _standby_pending_count = 0;
+    }
+}
+
+void ROKOR_Mesh::processStandbySync()
+{
+    if (!_standby_present)
+        return;
+    uint32_t current_time = millis();
+    if (current_time - _standby_last_heard > STANDBY_LEASE_MS)
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[GW] Standby gateway lost."));
+#endif
+        _standby_present = false;
+        releasePeer(_standby_mac);
+        return;
+    }
+
+    uint8_t frame[3 + STANDBY_SYNC_MAX_RECORDS * LEASE_RECORD_LEN];
+    uint8_t flags = 0;
+    uint8_t count = 0;
+    if (_standby_snapshot_cursor != NODE_SLOT_NONE)
+    {
+        // Снимок идет частями, по кадру за вызов; изменения, накопленные за это время, уйдут после него
+        if (_standby_snapshot_cursor == 0)
+            flags |= STANDBY_SYNC_FLAG_SNAPSHOT_START;
+        uint8_t slot = _standby_snapshot_cursor;
+        for (; slot < ROKOR_MESH_MAX_NODES && count < STANDBY_SYNC_MAX_RECORDS; ++slot)
+        {
+            if (_known_nodes[slot].pjon_id == PJON_NOT_ASSIGNED)
+                continue;
+            uint8_t *record = &frame[3 + count * LEASE_RECORD_LEN];
+            record[0] = _known_nodes[slot].pjon_id;
+            memcpy(&record[1], _known_nodes[slot].mac_addr, ESP_NOW_ETH_ALEN);
+            count++;
+        }
+        while (slot < ROKOR_MESH_MAX_NODES && _known_nodes[slot].pjon_id == PJON_NOT_ASSIGNED)
+            slot++;
+        if (slot >= ROKOR_MESH_MAX_NODES)
+        {
+            flags |= STANDBY_SYNC_FLAG_SNAPSHOT_END;
+            _standby_snapshot_cursor = NODE_SLOT_NONE;
+        }
+        else
+        {
+            _standby_snapshot_cursor = slot;
+        }
+    }
+    else if (_standby_pending_count > 0)
+    {
+        count = _standby_pending_count;
+        memcpy(&frame[3], _standby_pending, count * LEASE_RECORD_LEN);
+        _standby_pending_count = 0;
+    }
+    else if (current_time - _standby_last_sync_sent < STANDBY_HEARTBEAT_MS)
+    {
+        return;
+    }
+
+    // Кадр с данными получает следующий номер, пульс повторяет последний
+    if (flags != 0 || count > 0)
+        _standby_tx_seq++;
+    frame[0] = (uint8_t)MeshDiscoveryMessage::GATEWAY_SYNC;
+    frame[1] = flags;
+    frame[2] = _standby_tx_seq;
+
+    // Потеря кадра обнаруживается резервом по номеру, поэтому без подтверждения PJON
+    selectPeer(_standby_mac);
+    _pjon_bus.set_receiver_id(PJON_BROADCAST_ADDRESS);
+    _pjon_bus.set_acknowledge(false);
+    _pjon_bus.send_packet(frame, 3 + count * LEASE_RECORD_LEN);
+    _pjon_bus.set_acknowledge(true);
+    _standby_last_sync_sent = current_time;
+}
+
+void ROKOR_Mesh::enterStandby()
+{
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[FSM] Gateway ID %d found. -> STANDBY_GATEWAY\n"), _gatewayPjonId);
+#endif
+    initNodeManagement();
+    _current_role = ROLE_STANDBY_GATEWAY;
+    _fsm_state = DiscoveryFSM::STANDBY_GATEWAY;
+    _fsm_timer_start = millis();
+    _standby_last_sync_rx = _fsm_timer_start;
+    _standby_probes_sent = 0;
+    sendStandbyHello();
+}
+
+void ROKOR_Mesh::sendStandbyHello(bool probe)
+{
+    uint8_t payload[1 + ESP_NOW_ETH_ALEN + 3];
+    payload[0] = (uint8_t)MeshDiscoveryMessage::STANDBY_HELLO;
+    memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
+    payload[1 + ESP_NOW_ETH_ALEN] = _standby_synced ? 1 : 0;
+    payload[2 + ESP_NOW_ETH_ALEN] = _standby_rx_seq;
+    payload[3 + ESP_NOW_ETH_ALEN] = probe ? STANDBY_HELLO_FLAG_PROBE : 0;
+
+    selectPeer(_gateway_mac_addr);
+    _pjon_bus.set_receiver_id(_gatewayPjonId);
+    _pjon_bus.send(payload, sizeof(payload));
+    _standby_last_hello = millis();
+}
+
+void ROKOR_Mesh::handleGatewaySync(const uint8_t *payload, uint16_t length)
+{
+    if (length < 2)
+        return;
+    uint8_t flags = payload[0];
+    uint8_t seq = payload[1];
+    const uint8_t *records = payload + 2;
+    uint8_t count = (length - 2) / LEASE_RECORD_LEN;
+    bool has_data = flags != 0 || count > 0;
+
+    _standby_last_sync_rx = millis();
+    _standby_probes_sent = 0;
+    if (flags & STANDBY_SYNC_FLAG_SNAPSHOT_START)
+    {
+        initNodeManagement();
+        _standby_loading = true;
+    }
+    else if (!_standby_loading && !_standby_synced)
+    {
+        return; // Ждем начала нового снимка
+    }
+    else if (seq != (uint8_t)(_standby_rx_seq + (has_data ? 1 : 0)))
+    {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[Standby] Sync frame lost (got %d, last %d). Requesting snapshot.\n"), seq, _standby_rx_seq);
+#endif
+        _standby_loading = false;
+        _standby_synced = false;
+        sendStandbyHello();
+        return;
+    }
+    _standby_rx_seq = seq;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint8_t node_id = records[i * LEASE_RECORD_LEN];
+        const uint8_t *mac = &records[i * LEASE_RECORD_LEN + 1];
+        if (node_id == PJON_BROADCAST_ADDRESS || node_id == PJON_NOT_ASSIGNED)
+            continue;
+        int by_id = findNodeById(node_id);
+        if (by_id != -1)
+            removeNode(by_id);
+        if (memcmp(mac, _esp_now_null_mac, ESP_NOW_ETH_ALEN) == 0)
+            continue; // Узел удален шлюзом
+        int by_mac = findNodeByMac(mac);
+        if (by_mac != -1)
+            removeNode(by_mac);
+        addNode(node_id, mac);
+    }
+
+    if (flags & STANDBY_SYNC_FLAG_SNAPSHOT_END)
+    {
+        _standby_loading = false;
+        _standby_synced = true;
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.printf(F("[Standby] Snapshot received: %d nodes.\n"), _known_nodes_count);
+#endif
+    }
+}
+
+void ROKOR_Mesh::operateAsStandby()
+{
+    uint32_t current_time = millis();
+    // До первого снимка шлюз мог еще не ответить, поэтому молчание до тайм-аута поиска не считается отказом
+    uint32_t silence_limit = _standby_synced ? STANDBY_TAKEOVER_MS : _discovery_timeout_ms;
+    if (current_time - _standby_last_sync_rx > silence_limit)
+    {
+        if (_standby_synced)
+        {
+            // Пропуск пульса еще не отказ шлюза (потеря кадров, занятый эфир): сначала прямые запросы,
+            // ответ на любой из них (GATEWAY_SYNC) сбрасывает счетчик в handleGatewaySync()
+            if (current_time - _standby_last_hello < STANDBY_PROBE_INTERVAL_MS)
+                return;
+            if (_standby_probes_sent < STANDBY_PROBE_ATTEMPTS)
+            {
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+                Serial.printf(F("[Standby] No heartbeat for %lu ms. Probing gateway (%d).\n"),
+                              (unsigned long)(current_time - _standby_last_sync_rx), _standby_probes_sent + 1);
+#endif
+                _standby_probes_sent++;
+                sendStandbyHello(true);
+                return;
+            }
+            takeOverAsGateway();
+            return;
+        }
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+        Serial.println(F("[Standby] No table sync from gateway. -> LISTEN_FOR_GATEWAY"));
+#endif
+        initNodeManagement();
+        _current_role = ROLE_DISCOVERING;
+        _gatewayPjonId = PJON_NOT_ASSIGNED;
+        memset(_gateway_mac_addr, 0, ESP_NOW_ETH_ALEN);
+        _fsm_state = DiscoveryFSM::LISTEN_FOR_GATEWAY;
+        _fsm_timer_start = current_time;
+        return;
+    }
+    if (current_time - _standby_last_hello >= STANDBY_HELLO_INTERVAL_MS)
+    {
+        sendStandbyHello();
+    }
+}
+
+void ROKOR_Mesh::takeOverAsGateway()
+{
+    uint32_t current_time = millis();
+#ifdef ROKOR_MESH_DEBUG_SERIAL
+    Serial.printf(F("[Standby] Gateway silent for %lu ms. Taking over as ID %d with %d nodes.\n"),
+                  (unsigned long)(current_time - _standby_last_sync_rx), _gatewayPjonId, _known_nodes_count);
+#endif
+    releasePeer(_gateway_mac_addr);
+    _current_role = ROLE_GATEWAY;
+    _myPjonId = _gatewayPjonId;
+    _pjonIdForGatewayUse = _myPjonId;
+    _standby_synced = false;
+    initializePjonStack(_myPjonId, _pjon_bus_id, true);
+    if (!_pjon_bus.is_listening())
+    {
+        _fsm_state = DiscoveryFSM::ERROR_STATE;
+        return;
+    }
+
+    // Колесо на резерве не вращалось: сроки всех узлов отсчитываются от смены шлюза
+    memset(_liveness_wheel, NODE_SLOT_NONE, sizeof(_liveness_wheel));
+    _liveness_cursor = 0;
+    _liveness_next_tick = current_time + LIVENESS_TICK_MS;
+    for (uint8_t i = 0; i < ROKOR_MESH_MAX_NODES; ++i)
+    {
+        if (_known_nodes[i].pjon_id == PJON_NOT_ASSIGNED)
+            continue;
+        _known_nodes[i].last_seen = current_time;
+        _known_nodes[i].wheel_bucket = NODE_SLOT_NONE;
+        scheduleLiveness(i);
+    }
+    markLeasesDirty();
+    saveConfigToNVS();
+    _fsm_state = DiscoveryFSM::OPERATIONAL_GATEWAY;
+    _fsm_timer_start = current_time;
+
+    // Узлы узнают новый MAC шлюза из объявления; частые первые объявления Trickle покрывают потерю кадра
+    startAnnounceTrickle();
 }
 
 void ROKOR_Mesh::sendNodeIdRequest()
@@ -1738,9 +4813,11 @@ void ROKOR_Mesh::sendNodeIdRequest()
     payload[0] = (uint8_t)MeshDiscoveryMessage::NODE_ID_REQUEST;
     memcpy(&payload[1], _my_mac_addr, ESP_NOW_ETH_ALEN);
 
-    _pjon_bus.strategy.set_receiver_mac(_gateway_mac_addr);
+    selectPeer(_gateway_mac_addr);
     _pjon_bus.set_receiver_id(_gatewayPjonId);
     _pjon_bus.send(payload, sizeof(payload));
+    _next_node_id_request_time = millis() + _node_id_retry_window_ms / 2 + esp_random() % (_node_id_retry_window_ms / 2 + 1);
+    _node_id_retry_window_ms = std::min(_node_id_retry_window_ms * 2, NODE_ID_RETRY_MAX_MS);
 #ifdef ROKOR_MESH_DEBUG_SERIAL
     Serial.printf(F("[Node] Sent NODE_ID_REQUEST to Gateway ID %d (MAC %02X:%02X).\n"), _gatewayPjonId, _gateway_mac_addr[0], _gateway_mac_addr[1]);
 #endif
@@ -1756,7 +4833,7 @@ void ROKOR_Mesh::sendNodeIdAck()
         return;
     }
     uint8_t payload[] = {(uint8_t)MeshDiscoveryMessage::NODE_ID_ACK};
-    _pjon_bus.strategy.set_receiver_mac(_gateway_mac_addr);
+    selectPeer(_gateway_mac_addr);
     _pjon_bus.set_receiver_id(_gatewayPjonId);
     _pjon_bus.send(payload, sizeof(payload));
 #ifdef ROKOR_MESH_DEBUG_SERIAL
@@ -21,27 +21,160 @@
 #include <strategies/ESPNOW/ESPNOW.h>
 #include "esp_now.h"
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <atomic>
 
 // Константы из спецификации
 #define ROKOR_MESH_DEFAULT_GATEWAY_ID 1
 #define ROKOR_MESH_MAX_NETWORK_NAME_LEN 32
 #define ROKOR_MESH_ESPNOW_PMK_LEN 16
 #define ROKOR_MESH_MAX_PAYLOAD_SIZE 200
+// Версия протокола в GATEWAY_ANNOUNCE и GATEWAY_CLAIM. 2 - сообщения приложения с заголовком
+// [APP_MESSAGE][тип]; объявления прошивок версии 1 (без поля версии) игнорируются.
+#define ROKOR_MESH_PROTOCOL_VERSION 2
+// Тип сообщения для вызовов без явного типа (sendMessage(dest, payload, len) и т.п.)
+#define ROKOR_MESH_DEFAULT_MESSAGE_TYPE 0
+
+// Размеры внутренних буферов. Переопределяются флагом сборки (-D) для всего проекта,
+// а не #define в скетче: от них зависит раскладка класса ROKOR_Mesh.
+
+// Емкость очереди отправки
+#ifndef ROKOR_MESH_TX_QUEUE_SIZE
+#define ROKOR_MESH_TX_QUEUE_SIZE 8
+#endif
+#define ROKOR_MESH_INVALID_TX_HANDLE 0
+
+// Максимальный размер сообщения, которое может быть объединено с другими в один кадр
+#ifndef ROKOR_MESH_BATCH_MAX_ITEM_SIZE
+#define ROKOR_MESH_BATCH_MAX_ITEM_SIZE 32
+#endif
+
+// Число узлов в таблице шлюза (1..253, все PJON ID кроме 0, 255 и ID шлюза). Память шлюза:
+// 36 байт на узел + 256 байт индекса ID + хеш-таблица MAC (64 байта до 32 узлов, 128 - до 64,
+// 256 - до 128, 512 - до 253). Например, 30 узлов - ~1.4 КБ, 253 узла - ~9.7 КБ.
+#ifndef ROKOR_MESH_MAX_NODES
+#define ROKOR_MESH_MAX_NODES 30
+#endif
+static_assert(ROKOR_MESH_MAX_NODES >= 1 && ROKOR_MESH_MAX_NODES <= 253, "ROKOR_MESH_MAX_NODES must be 1..253");
+
+// Группы узлов для групповой рассылки (шлюз)
+#ifndef ROKOR_MESH_MAX_NODE_GROUPS
+#define ROKOR_MESH_MAX_NODE_GROUPS 4
+#endif
+
+// Максимальный размер сообщения, передаваемого фрагментами (не более 255 фрагментов)
+#ifndef ROKOR_MESH_MAX_MESSAGE_SIZE
+#define ROKOR_MESH_MAX_MESSAGE_SIZE 4096
+#endif
+static_assert(ROKOR_MESH_MAX_MESSAGE_SIZE + 2 <= 255 * (ROKOR_MESH_MAX_PAYLOAD_SIZE - 5), "ROKOR_MESH_MAX_MESSAGE_SIZE exceeds 255 fragments");
+
+// Число одновременных сборок фрагментированных сообщений (всего и от одного отправителя)
+#ifndef ROKOR_MESH_REASSEMBLY_SLOTS
+#define ROKOR_MESH_REASSEMBLY_SLOTS 2
+#endif
+#ifndef ROKOR_MESH_REASSEMBLY_PER_SENDER
+#define ROKOR_MESH_REASSEMBLY_PER_SENDER 1
+#endif
+
+// Кольцо принятых кадров между callback-ом ESP-NOW (задача WiFi) и update(); вмещает на один кадр меньше
+#ifndef ROKOR_MESH_RX_RING_SIZE
+#define ROKOR_MESH_RX_RING_SIZE 16
+#endif
+static_assert(ROKOR_MESH_RX_RING_SIZE >= 2 && ROKOR_MESH_RX_RING_SIZE <= 256, "ROKOR_MESH_RX_RING_SIZE must be 2..256");
+
+// Очередь событий (callback-ов) от задачи сети к приложению, см. setMeshTask()
+#ifndef ROKOR_MESH_EVENT_QUEUE_SIZE
+#define ROKOR_MESH_EVENT_QUEUE_SIZE 16
+#endif
+
+// Пакетная доставка принятых сообщений (setBatchReceiveCallback): записей и байт данных за один update()
+#ifndef ROKOR_MESH_RX_BATCH_SIZE
+#define ROKOR_MESH_RX_BATCH_SIZE 16
+#endif
+#ifndef ROKOR_MESH_RX_BATCH_BUFFER_SIZE
+#define ROKOR_MESH_RX_BATCH_BUFFER_SIZE 1024
+#endif
+
+// Пиры ESP-NOW, которые библиотека держит зарегистрированными одновременно (кроме широковещательного).
+// Пир регистрируется перед отправкой ему, при нехватке места удаляется давно не использованный.
+// С шифрованием (PMK) емкость дополнительно ограничена ESP_NOW_MAX_ENCRYPT_PEER_NUM.
+#ifndef ROKOR_MESH_PEER_CACHE_SIZE
+#define ROKOR_MESH_PEER_CACHE_SIZE (ESP_NOW_MAX_TOTAL_PEER_NUM - 1)
+#endif
+
+static_assert(ROKOR_MESH_PEER_CACHE_SIZE >= 1 && ROKOR_MESH_PEER_CACHE_SIZE < ESP_NOW_MAX_TOTAL_PEER_NUM, "ROKOR_MESH_PEER_CACHE_SIZE must be 1..ESP_NOW_MAX_TOTAL_PEER_NUM-1");
+static_assert(ROKOR_MESH_RX_BATCH_SIZE >= 1 && ROKOR_MESH_RX_BATCH_SIZE <= 255, "ROKOR_MESH_RX_BATCH_SIZE must be 1..255");
 
 class ROKOR_Mesh;
 
 extern ROKOR_Mesh *global_ROKOR_Mesh_instance;
 
 typedef void (*ROKOR_Mesh_ReceiveCallback)(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr);
+typedef void (*ROKOR_Mesh_MessageHandler)(uint8_t senderId, const uint8_t *payload, uint16_t length, void *custom_ptr);
 typedef void (*ROKOR_Mesh_GatewayStatusCallback)(bool connected, void *custom_ptr);
 typedef void (*ROKOR_Mesh_NodeStatusCallback)(uint8_t nodeId, bool isConnected, void *custom_ptr);
 
+typedef uint16_t ROKOR_Mesh_TxHandle;
+
+// Принятое сообщение в пакете setBatchReceiveCallback(); payload действителен только во время вызова callback-а
+struct ROKOR_Mesh_RxRecord
+{
+    uint8_t sender_id;
+    uint8_t message_type;
+    uint16_t length;
+    const uint8_t *payload;
+    uint32_t rx_time_us; // micros() в момент приема кадра
+};
+typedef void (*ROKOR_Mesh_BatchReceiveCallback)(const ROKOR_Mesh_RxRecord *records, uint8_t count, void *custom_ptr);
+
+enum ROKOR_Mesh_TxStatus
+{
+    TX_STATUS_ACK,
+    TX_STATUS_FAIL,
+    TX_STATUS_TIMEOUT,
+    TX_STATUS_PARTIAL // Групповая рассылка: подтвердили не все адресаты
+};
+
+// Буфер слота очереди отправки для заполнения "на месте" (acquireTxBuffer/commitTx)
+struct ROKOR_Mesh_TxBuffer
+{
+    ROKOR_Mesh_TxHandle handle;
+    uint8_t *data;
+    uint16_t capacity;
+};
+
+// Сглаженное время кругового обхода (RTT) и производный таймаут повтора до соседа
+struct ROKOR_Mesh_LinkStats
+{
+    uint32_t srtt_us;   // Сглаженный RTT, мкс (0 - измерений еще не было)
+    uint32_t rttvar_us; // Разброс RTT, мкс
+    uint32_t rto_ms;    // Текущий таймаут повтора
+    uint16_t samples;   // Число учтенных измерений
+};
+
+// Статистика кэша пиров ESP-NOW (getPeerCacheStats)
+struct ROKOR_Mesh_PeerCacheStats
+{
+    uint32_t hits;      // Отправок пиру, уже зарегистрированному в ESP-NOW
+    uint32_t misses;    // Отправок, потребовавших регистрации пира
+    uint32_t evictions; // Пиров, удаленных ради нового
+    uint8_t peers;      // Зарегистрировано сейчас
+    uint8_t capacity;   // Емкость кэша с учетом шифрования
+};
+
+typedef void (*ROKOR_Mesh_TxCompleteCallback)(ROKOR_Mesh_TxHandle handle, uint8_t destinationId, ROKOR_Mesh_TxStatus status, void *custom_ptr);
+typedef void (*ROKOR_Mesh_MulticastAckCallback)(ROKOR_Mesh_TxHandle handle, uint8_t nodeId, void *custom_ptr);
+
 enum ROKOR_Mesh_Role
 {
     ROLE_UNINITIALIZED,
     ROLE_DISCOVERING,
     ROLE_NODE,
     ROLE_GATEWAY,
+    ROLE_STANDBY_GATEWAY, // Резервный шлюз: держит копию таблицы узлов активного шлюза (setStandbyGateway)
     ROLE_ERROR
 };
 
@@ -58,18 +191,65 @@ public:
 
     void forceRoleNode(uint8_t pjonId, uint8_t gatewayToConnectPjonId = 0);
     void forceRoleGateway(uint8_t pjonId = ROKOR_MESH_DEFAULT_GATEWAY_ID);
+    // Резервный шлюз (вызывать до begin()): найдя шлюз, устройство не становится узлом, а держит копию
+    // таблицы узлов шлюза и, если шлюз замолчал, занимает его место с тем же PJON ID
+    void setStandbyGateway(bool enabled);
 
     void update();
+    // update() без ожидания приема: обрабатывается только уже пришедшее, управление возвращается сразу
+    void setNonBlockingUpdate(bool enabled);
+    // Ждет принятого кадра или новой отправки не дольше timeout_ms (для неблокирующего update()).
+    // true - есть работа для update().
+    bool waitForActivity(uint32_t timeout_ms);
+    // Дополнительно будить задачу уведомлением (ulTaskNotifyTake) при каждом принятом кадре; nullptr - отключить
+    void setActivityNotifyTask(TaskHandle_t task);
+    // Обслуживание сети в отдельной задаче FreeRTOS (вызывать до begin()). Callback-и приложения
+    // в этом режиме вызываются из update() в задаче приложения через потокобезопасную очередь событий.
+    void setMeshTask(bool enabled, BaseType_t core = 0, UBaseType_t priority = 5, uint32_t stackSize = 6144);
+    // Число событий, отброшенных из-за переполнения очереди событий
+    uint32_t getEventOverflowCount() const;
 
     bool sendMessage(uint8_t destinationId, const uint8_t *payload, uint16_t length);
     bool sendMessage(const uint8_t *payload, uint16_t length);
-
+    // Сообщение с типом messageType: на приемной стороне вызывается обработчик, заданный onMessage()
+    bool sendMessage(uint8_t destinationId, uint8_t messageType, const uint8_t *payload, uint16_t length);
+
+    // Ставит сообщение в очередь отправки. Возвращает handle или ROKOR_MESH_INVALID_TX_HANDLE.
+    // Сообщение длиннее ROKOR_MESH_MAX_PAYLOAD_SIZE уходит фрагментами; одновременно передается только
+    // одно такое сообщение (на любой адрес): пока не пришел его TxComplete, следующее получит
+    // ROKOR_MESH_INVALID_TX_HANDLE. Короткие сообщения очередь принимает и во время передачи фрагментов.
+    ROKOR_Mesh_TxHandle enqueueMessage(uint8_t destinationId, const uint8_t *payload, uint16_t length);
+    ROKOR_Mesh_TxHandle enqueueMessage(uint8_t destinationId, uint8_t messageType, const uint8_t *payload, uint16_t length);
+    uint8_t getTxQueueCount() const;
+
+    // Резервирует слот очереди; приложение пишет данные прямо в buffer.data и вызывает commitTx()
+    // (или abortTx()). При ошибке buffer.data == nullptr.
+    ROKOR_Mesh_TxBuffer acquireTxBuffer(uint8_t destinationId, uint16_t maxLen, uint8_t messageType = ROKOR_MESH_DEFAULT_MESSAGE_TYPE);
+    bool commitTx(ROKOR_Mesh_TxHandle handle, uint16_t length);
+    void abortTx(ROKOR_Mesh_TxHandle handle);
+
+    // Групповая рассылка (шлюз): один широковещательный кадр с битовой картой адресатов
+    ROKOR_Mesh_TxHandle sendToMany(const uint8_t *ids, uint8_t count, const uint8_t *payload, uint16_t length, bool requestAck = false);
+    ROKOR_Mesh_TxHandle sendToMany(const uint8_t *ids, uint8_t count, uint8_t messageType, const uint8_t *payload, uint16_t length, bool requestAck = false);
+    bool setNodeGroup(uint8_t groupId, const uint8_t *ids, uint8_t count);
+    ROKOR_Mesh_TxHandle sendToGroup(uint8_t groupId, const uint8_t *payload, uint16_t length, bool requestAck = false);
+    ROKOR_Mesh_TxHandle sendToGroup(uint8_t groupId, uint8_t messageType, const uint8_t *payload, uint16_t length, bool requestAck = false);
+
+    // Сообщения без обработчика своего типа получает callback setReceiveCallback()
     void setReceiveCallback(ROKOR_Mesh_ReceiveCallback callback, void *custom_ptr = nullptr);
+    // Вместо setReceiveCallback(): все сообщения, принятые за один update(), одним вызовом в конце update()
+    void setBatchReceiveCallback(ROKOR_Mesh_BatchReceiveCallback callback, void *custom_ptr = nullptr);
+    // Обработчик сообщений типа messageType; nullptr - снять обработчик
+    void onMessage(uint8_t messageType, ROKOR_Mesh_MessageHandler handler, void *custom_ptr = nullptr);
     void setGatewayStatusCallback(ROKOR_Mesh_GatewayStatusCallback callback, void *custom_ptr = nullptr);
     void setNodeStatusCallback(ROKOR_Mesh_NodeStatusCallback callback, void *custom_ptr = nullptr);
+    void setTxCompleteCallback(ROKOR_Mesh_TxCompleteCallback callback, void *custom_ptr = nullptr);
+    void setMulticastAckCallback(ROKOR_Mesh_MulticastAckCallback callback, void *custom_ptr = nullptr);
 
     ROKOR_Mesh_Role getRole() const;
     uint8_t getPjonId() const;
+    // ID шлюза (узел), PJON_NOT_ASSIGNED - шлюз еще не найден
+    uint8_t getGatewayId() const;
     const uint8_t *getBusId() const;
     const char *getNetworkName() const;
     bool isNetworkActive() const;
@@ -78,9 +258,45 @@ public:
 
     void setDiscoveryTimeout(uint32_t timeout_ms);
     void setGatewayContentionWindow(uint32_t window_ms);
+    // Приоритет на выборах шлюза: побеждает больший, при равенстве - меньший MAC (по умолчанию 0)
+    void setGatewayPriority(uint8_t priority);
+    // Потолок интервала GATEWAY_ANNOUNCE (таймер Trickle), по умолчанию 10000 мс. Когда все узлы сети ищут шлюз запросом
+    // GATEWAY_SOLICIT, его можно увеличить
     void setGatewayAnnounceInterval(uint32_t interval_ms);
     void setNodePingGatewayInterval(uint32_t interval_ms);
     void setNodeMaxGatewayPingAttempts(uint8_t attempts);
+    // Шлюз: узел без кадров дольше timeout_ms считается отключенным (0 = интервал опроса * (попыток + 1))
+    void setNodeInactivityTimeout(uint32_t timeout_ms);
+    // Шлюз: широковещательный маяк с картой активных ID каждые interval_ms вместо ответа на каждый пинг (0 - выключен)
+    void setLivenessBeacon(uint32_t interval_ms);
+    void setTxTimeout(uint32_t timeout_ms);
+    // Объединение мелких сообщений одному адресату в один кадр (окно window_ms или до заполнения кадра)
+    void setBatching(bool enabled, uint32_t window_ms = 20);
+    // Число фрагментов, отправляемых без ожидания подтверждения (1 = ожидание после каждого фрагмента)
+    void setFragmentWindow(uint8_t fragments);
+    // Надежный потоковый режим узел<->шлюз: до window кадров DATA в полете, выборочное подтверждение (SACK)
+    void setReliableStream(bool enabled, uint8_t window = 8);
+
+    // Оценка канала до соседа (узел: шлюз; шлюз: узел). false, если сосед неизвестен.
+    bool getLinkStats(uint8_t peerId, ROKOR_Mesh_LinkStats &stats) const;
+    // Число кадров, отброшенных из-за переполнения кольца приема
+    uint32_t getRxOverflowCount() const;
+    // Число принятых кадров без заголовка сообщения приложения (например, от прошивки версии 1), они отброшены
+    uint32_t getUnknownFrameCount() const;
+    // Попадания и промахи кэша пиров ESP-NOW
+    void getPeerCacheStats(ROKOR_Mesh_PeerCacheStats &stats) const;
+    void resetPeerCacheStats();
+
+    // (Шлюз) Регистрирует узел с известным ID и MAC без NODE_ID_REQUEST (например, узел с forceRoleNode())
+    bool registerNode(uint8_t nodeId, const uint8_t mac[6]);
+    // (Шлюз) Выдает узлу с этим MAC свободный ID заранее (как при NODE_ID_REQUEST); PJON_NOT_ASSIGNED - нет места
+    uint8_t assignNodeId(const uint8_t mac[6]);
+    // (Шлюз) ID из диапазона не выдаются автоматически (например, заданные узлам через forceRoleNode())
+    bool reserveNodeIds(uint8_t firstId, uint8_t lastId);
+    void clearReservedNodeIds();
+    // (Шлюз) ID узла с этим MAC или PJON_NOT_ASSIGNED
+    uint8_t getNodeIdByMac(const uint8_t mac[6]) const;
+    uint8_t getNodeCount() const;
 
 private:
     PJON<ESPNOW> _pjon_bus;
@@ -98,10 +314,23 @@ private:
 
     ROKOR_Mesh_ReceiveCallback _user_receive_cb;
     void *_user_receive_cb_custom_ptr;
+    // Таблица обработчиков по типу сообщения: маршрутизация - одно обращение по индексу
+    struct MessageRoute
+    {
+        ROKOR_Mesh_MessageHandler handler;
+        void *custom_ptr;
+    };
+    MessageRoute _message_routes[256];
+    ROKOR_Mesh_BatchReceiveCallback _user_batch_receive_cb;
+    void *_user_batch_receive_cb_custom_ptr;
     ROKOR_Mesh_GatewayStatusCallback _user_gateway_status_cb;
     void *_user_gateway_status_cb_custom_ptr;
     ROKOR_Mesh_NodeStatusCallback _user_node_status_cb;
     void *_user_node_status_cb_custom_ptr;
+    ROKOR_Mesh_TxCompleteCallback _user_tx_complete_cb;
+    void *_user_tx_complete_cb_custom_ptr;
+    ROKOR_Mesh_MulticastAckCallback _user_multicast_ack_cb;
+    void *_user_multicast_ack_cb_custom_ptr;
 
     bool _is_begun;
 
@@ -116,29 +345,52 @@ private:
         REQUEST_NODE_ID,
         OPERATIONAL_NODE,
         OPERATIONAL_GATEWAY,
+        STANDBY_GATEWAY,
         ERROR_STATE
     };
     DiscoveryFSM _fsm_state;
     uint32_t _fsm_timer_start;
     uint8_t _my_mac_addr[6];
+    uint8_t _gateway_mac_addr[6];
+
+    static const uint8_t _esp_now_broadcast_mac[ESP_NOW_ETH_ALEN];
+    static const uint8_t _esp_now_null_mac[ESP_NOW_ETH_ALEN];
 
     uint32_t _discovery_timeout_ms;
     uint32_t _gateway_contention_window_ms;
+    uint8_t _gateway_priority;
+    bool _standby_enabled;
     uint32_t _gateway_announce_interval_ms;
     uint32_t _node_ping_gateway_interval_ms;
     uint8_t _node_max_gateway_ping_attempts;
-    uint32_t _last_gateway_announce_time;
+    uint32_t _announce_trickle_interval_ms; // Текущий интервал Trickle, не больше _gateway_announce_interval_ms
+    uint32_t _next_gateway_announce_time;
 
-    void initializePjonStack(uint8_t pjon_id, const uint8_t bus_id[4]);
+    void initializePjonStack(uint8_t pjon_id, const uint8_t bus_id[4], bool is_gateway);
     void hashStringToBytes(const char *str, uint8_t *output_bytes, uint8_t num_bytes);
     void preparePmk(const char *input_pmk_or_network_name, char *output_pmk_buffer);
 
     void runDiscoveryFSM();
+    void operateAsNode();
+    void operateAsGateway();
+    void operateAsStandby();
 
-    void loadConfigFromNVS();
+    bool loadConfigFromNVS();
     void saveConfigToNVS();
     void clearConfigNVS();
 
+    // Аренды шлюза (MAC -> PJON ID) в NVS: после перезагрузки известные узлы обслуживаются сразу с прежними ID.
+    // Изменения таблицы узлов копятся и записываются одной записью (см. saveLeasesIfDue)
+    // Запись: [версия][число записей][записи [ID][MAC]...]. Заголовок не зависит от ROKOR_MESH_MAX_NODES,
+    // поэтому таблицу читает и прошивка с другим размером (лишние записи отбрасываются).
+    static const uint8_t LEASE_RECORD_LEN = 1 + ESP_NOW_ETH_ALEN; // [ID][MAC]
+    static const uint8_t LEASE_HEADER_LEN = 2;
+    static const uint8_t LEASE_BLOB_VERSION = 1;
+    void markLeasesDirty();
+    void saveLeasesIfDue();
+    void saveLeasesToNVS();
+    void loadLeasesFromNVS();
+
     static void _staticPjonReceiver(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info);
     static void _staticPjonError(uint8_t code, uint16_t data, void *custom_pointer);
 
@@ -149,41 +401,435 @@ private:
     uint32_t _last_ack_from_gateway_time;
     uint32_t _next_gateway_ping_time;
     uint8_t _failed_gateway_pings_count;
+    bool _rejoin_probing; // Быстрая проверка шлюза (после старта или неудачной доставки): пинги с короткими растущими паузами
+    // Маяк шлюза (узел): период из последнего маяка (0 - маяков нет) и его номер
+    uint32_t _gw_beacon_period_ms;
+    uint32_t _last_gw_beacon_time;
+    uint8_t _gw_beacon_seq;
+    // Подтвержденный обмен с соседом доказывает, что связь есть: узел откладывает пинг, шлюз продлевает срок узла
+    void noteLinkAlive(uint8_t peer_id);
+    void noteGatewayAlive();
+    void confirmGatewayLink(); // Связь подтверждена, но шлюз мог не слышать узел: пинг не откладывается
+    void handleLivenessBeacon(const uint8_t *payload, uint16_t length);
+    void suspectGatewayLink(uint8_t peer_id); // Сообщение не доставлено после всех попыток
+
+    // Состояние канала с одним соседом (узел: шлюз; шлюз: каждый узел)
+    struct PeerLink
+    {
+        uint16_t tx_next_seq;
+        uint16_t rx_highest_seq; // Старший принятый номер
+        uint32_t rx_bitmap;      // Бит i = принят номер rx_highest_seq - i; 0 = еще ничего не принято
+        uint32_t srtt_us;        // Сглаженный RTT (0 - измерений еще не было)
+        uint32_t rttvar_us;
+        uint16_t rtt_samples;
+    };
 
-    static const uint8_t MAX_NODES_PER_GATEWAY = 30;
     struct NodeInfo
     {
         uint8_t pjon_id;
         uint8_t mac_addr[6];
         uint32_t last_seen;
         bool id_assigned_this_session;
+        uint8_t wheel_next; // Следующий в корзине колеса; у свободного слота - следующий свободный
+        uint8_t wheel_prev;
+        uint8_t wheel_bucket; // NODE_SLOT_NONE - не в колесе
+        PeerLink link;
     };
-    NodeInfo _known_nodes[MAX_NODES_PER_GATEWAY];
+    NodeInfo _known_nodes[ROKOR_MESH_MAX_NODES]; // Слоты не переносятся; свободный слот: pjon_id == PJON_NOT_ASSIGNED
     uint8_t _known_nodes_count;
+    uint8_t _node_free_head; // Список свободных слотов (через wheel_next)
     uint8_t _next_available_node_id_candidate;
+    uint32_t _node_inactivity_timeout_ms;
+    uint32_t _liveness_beacon_interval_ms; // Шлюз: 0 - маяк выключен
+    uint32_t _last_liveness_beacon_time;
+    uint8_t _liveness_beacon_seq;
+    uint32_t _next_claim_time; // Кандидат: следующая заявка GATEWAY_CLAIM
+    uint32_t _next_solicit_time; // Узел: следующий GATEWAY_SOLICIT
+    uint32_t _next_node_id_request_time; // Узел: следующий повтор NODE_ID_REQUEST
+    uint32_t _node_id_retry_window_ms;   // Узел: окно случайной задержки повтора NODE_ID_REQUEST
+
+    // Индекс PJON ID -> слот и хеш-таблица MAC -> слот (открытая адресация, линейное пробирование, заполнение <= 1/2)
+    static const uint8_t NODE_SLOT_NONE = 0xFF;
+    static const uint16_t NODE_MAC_HASH_SIZE = ROKOR_MESH_MAX_NODES <= 32 ? 64 : ROKOR_MESH_MAX_NODES <= 64 ? 128 : ROKOR_MESH_MAX_NODES <= 128 ? 256 : 512;
+    uint8_t _node_id_index[256];
+    uint8_t _node_mac_hash[NODE_MAC_HASH_SIZE];
+    // Зарегистрированные (есть в таблице узлов) и зарезервированные ID (бит i = ID i); свободный ID ищется по словам через __builtin_ctz.
+    // Карта зарегистрированных ID уходит в LIVENESS_BEACON: узел в ней, пока колесо активности не удалило его из таблицы
+    static const uint8_t NODE_ID_WORDS = 8;
+    uint32_t _node_id_registered[NODE_ID_WORDS];
+    uint32_t _node_id_reserved[NODE_ID_WORDS];
+    // Колесо таймеров активности: узел лежит в корзине такта, на котором истекает его срок.
+    // Прием кадра обновляет только last_seen; при срабатывании корзины узел удаляется или переносится на новый срок.
+    static const uint8_t LIVENESS_WHEEL_SIZE = 64;
+    uint8_t _liveness_wheel[LIVENESS_WHEEL_SIZE];
+    uint8_t _liveness_cursor; // Корзина следующего такта
+    uint32_t _liveness_next_tick;
+    // Несохраненные изменения аренд (таблицы узлов)
+    bool _leases_dirty;
+    uint32_t _leases_first_change;
+    uint32_t _leases_last_change;
 
     void initNodeManagement();
     void handleNodeIdRequest(const PJON_Packet_Info &request_info, const uint8_t *mac_from_payload);
     void sendPjonIdAssignment(uint8_t assigned_id, const uint8_t target_mac[6]);
-    void cleanupInactiveNodes();
-    uint8_t findNodeByMac(const uint8_t mac[6]);
-    uint8_t findNodeById(uint8_t id);
-    void updateNodeStatus(uint8_t nodeId, bool isConnected);
-
-    void espNowInit();
+    uint32_t nodeInactivityTimeout() const;
+    void scheduleLiveness(uint8_t slot);
+    void unlinkLiveness(uint8_t slot);
+    void advanceLivenessWheel();
+    int findNodeByMac(const uint8_t mac[6]) const;
+    int findNodeById(uint8_t id) const;
+    int addNode(uint8_t node_id, const uint8_t mac[6]);
+    uint8_t allocateNodeId();
+    uint32_t freeNodeIdBits(uint8_t word) const; // Свободные для выдачи ID слова битовой карты
+    bool isNodeIdFree(uint8_t id) const;
+    void removeNode(uint8_t slot);
+    static uint16_t hashMac(const uint8_t mac[6]);
+    void insertMacHash(uint8_t slot);
+    void eraseMacHash(uint8_t slot);
+    void updateNodeStatus(uint8_t nodeId, bool isConnected, const char *reason);
+
+    // Заголовок приложения: [APP_MESSAGE][тип сообщения][данные]
+    static const uint8_t APP_HEADER_LEN = 2;
+    static const uint16_t TX_FRAME_SIZE = ROKOR_MESH_MAX_PAYLOAD_SIZE + APP_HEADER_LEN;
+
+    // Очередь отправки (кольцевой буфер, разбирается в update())
+    static const uint8_t DATA_HEADER_LEN = 4; // type, flags, seq (2 байта)
+    enum class TxSlotState : uint8_t
+    {
+        FREE,
+        RESERVED,
+        PENDING,
+        DONE
+    };
+    struct TxSlot
+    {
+        TxSlotState state;
+        ROKOR_Mesh_TxHandle handle;
+        uint8_t destination_id;
+        uint8_t attempts;
+        uint16_t length;
+        uint32_t enqueue_time;
+        uint32_t next_attempt_time;
+        bool batch_open;       // Кадр BATCH еще принимает сообщения
+        bool seq_assigned;     // Номер seq присвоен при первой передаче кадра DATA
+        bool stream_in_flight; // Кадр DATA отправлен, ждем STREAM_ACK
+        uint16_t seq;
+        uint32_t stream_sent_us;
+        // Перед сообщением оставлено место под заголовок DATA: он пишется на месте, сообщение не копируется
+        uint8_t frame[DATA_HEADER_LEN + TX_FRAME_SIZE];
+        uint8_t *data; // frame + DATA_HEADER_LEN
+    };
+    TxSlot _tx_queue[ROKOR_MESH_TX_QUEUE_SIZE];
+    volatile uint8_t _tx_head;
+    volatile uint8_t _tx_tail;
+    volatile uint8_t _tx_count;
+    ROKOR_Mesh_TxHandle _tx_next_handle;
+    uint32_t _tx_timeout_ms;
+    bool _batching_enabled;
+    uint32_t _batch_window_ms;
+    portMUX_TYPE _tx_queue_mux;
+
+    void initTxQueue();
+    bool validateOutgoing(uint8_t destinationId, uint16_t length, uint16_t max_length = ROKOR_MESH_MAX_PAYLOAD_SIZE);
+    int reserveTxSlot(uint8_t destinationId);
+    int findTxSlot(ROKOR_Mesh_TxHandle handle);
+    void commitTxSlot(uint8_t slot_idx, uint16_t frame_length);
+    void processTxQueue();
+    void completeTxSlot(uint8_t slot_idx, ROKOR_Mesh_TxStatus status);
+    bool resolveDestinationMac(uint8_t destinationId, uint8_t *target_mac);
+    ROKOR_Mesh_TxHandle appendToBatch(uint8_t destinationId, uint8_t message_type, const uint8_t *payload, uint16_t length);
+    void closeBatch(TxSlot &slot);
+    void deliverUserPayload(uint8_t sender_id, const uint8_t *payload, uint16_t length);
+    void dispatchUserMessage(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length);
+
+    // Надежный поток: одноадресные кадры DATA пачками в пределах окна
+    static const uint8_t STREAM_SACK_BITS = 32;
+    bool _stream_enabled;
+    uint8_t _stream_window;
+    PeerLink _gateway_link;
+
+    void resetPeerLink(PeerLink &peer);
+    PeerLink *findPeerLink(uint8_t peer_id);
+    void addRttSample(uint8_t peer_id, uint32_t rtt_us);
+    uint32_t linkRtoMs(uint8_t peer_id);
+    static uint32_t computeRtoMs(const PeerLink &peer);
+    bool streamSeqAvailable(uint8_t destinationId, const PeerLink &peer);
+    void sendStreamBurst(const uint8_t *slot_indices, uint8_t count);
+    bool acceptSequence(PeerLink &peer, uint16_t seq);
+    void handleData(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length);
+    void handleStreamAck(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length);
+    void sendStreamAck(uint8_t peer_id, const PeerLink &peer);
+
+    // Групповая рассылка: битовая карта на все пространство PJON ID (бит i = ID i)
+    static const uint8_t NODE_ID_BITMAP_BYTES = 32;
+    static const uint8_t MULTICAST_TRACK_SIZE = 4;
+    // Рассылка с подтверждением: ответ засчитывается, только если seq совпал, узел есть среди
+    // ожидаемых адресатов и окно ответов (sent_time + deadline_ms) еще не истекло
+    struct MulticastTrack
+    {
+        ROKOR_Mesh_TxHandle handle; // ROKOR_MESH_INVALID_TX_HANDLE - запись свободна
+        uint8_t seq;
+        bool sent;            // Кадр ушел в эфир, окно ответов идет
+        uint8_t expected;     // Зарегистрированных адресатов на момент отправки
+        uint8_t acked;
+        uint32_t sent_time;
+        uint32_t deadline_ms;
+        uint8_t waiting[NODE_ID_BITMAP_BYTES]; // Адресаты, от которых еще нет MULTICAST_ACK
+    };
+    uint8_t _node_groups[ROKOR_MESH_MAX_NODE_GROUPS][NODE_ID_BITMAP_BYTES];
+    MulticastTrack _multicast_track[MULTICAST_TRACK_SIZE];
+    uint8_t _multicast_seq;
+    // Узел: MULTICAST_ACK ждет случайную задержку, чтобы ответы группы не совпали в эфире
+    bool _multicast_ack_pending;
+    uint8_t _multicast_ack_seq;
+    uint32_t _multicast_ack_due;
+
+    ROKOR_Mesh_TxHandle sendMulticast(const uint8_t *id_bitmap, uint8_t message_type, const uint8_t *payload, uint16_t length, bool requestAck);
+    void handleMulticast(const PJON_Packet_Info &packet_info, const uint8_t *frame, uint16_t frame_length);
+    void handleMulticastAck(uint8_t node_id, uint8_t seq);
+    MulticastTrack *findMulticastTrack(ROKOR_Mesh_TxHandle handle);
+    bool startMulticastTrack(ROKOR_Mesh_TxHandle handle);
+    void finishMulticastTrack(MulticastTrack &track);
+    void sendMulticastAck();
+    void processMulticastAcks();
+
+    // Фрагментация сообщений длиннее ROKOR_MESH_MAX_PAYLOAD_SIZE (фрагментами передается сообщение вместе с заголовком приложения)
+    static const uint8_t FRAGMENT_HEADER_LEN = 5; // type, msg_id, index, count, flags
+    static const uint16_t FRAGMENT_DATA_SIZE = ROKOR_MESH_MAX_PAYLOAD_SIZE - FRAGMENT_HEADER_LEN;
+    static const uint16_t FRAGMENT_MESSAGE_SIZE = ROKOR_MESH_MAX_MESSAGE_SIZE + APP_HEADER_LEN;
+    static const uint8_t FRAGMENT_MAX_COUNT = (FRAGMENT_MESSAGE_SIZE + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+    static const uint8_t FRAGMENT_BITMAP_BYTES = (FRAGMENT_MAX_COUNT + 7) / 8;
+
+    struct FragmentTx
+    {
+        bool active;
+        bool awaiting_status;
+        ROKOR_Mesh_TxHandle handle;
+        uint8_t destination_id;
+        uint8_t msg_id;
+        uint8_t frag_count;
+        uint8_t acked_count;
+        uint8_t stalled_rounds;
+        uint16_t length;
+        uint32_t start_time;
+        uint32_t timeout_ms;
+        uint32_t status_wait_start_us;
+        uint8_t acked[FRAGMENT_BITMAP_BYTES];
+        uint8_t in_flight[FRAGMENT_BITMAP_BYTES];
+        uint8_t data[FRAGMENT_MESSAGE_SIZE];
+    };
+    enum class ReassemblyState : uint8_t
+    {
+        FREE,
+        ACTIVE,
+        COMPLETE // Сообщение доставлено; слот хранит заголовок для повторного подтверждения
+    };
+    struct ReassemblySlot
+    {
+        ReassemblyState state;
+        uint8_t sender_id;
+        uint8_t msg_id;
+        uint8_t frag_count;
+        uint8_t received_count;
+        uint16_t length;
+        uint32_t last_activity;
+        uint8_t received[FRAGMENT_BITMAP_BYTES];
+        uint8_t data[FRAGMENT_MESSAGE_SIZE];
+    };
+    FragmentTx _fragment_tx;
+    ReassemblySlot _reassembly[ROKOR_MESH_REASSEMBLY_SLOTS];
+    uint8_t _fragment_window;
+    uint8_t _fragment_next_msg_id;
+
+    void initFragmentation();
+    ROKOR_Mesh_TxHandle startFragmentedTx(uint8_t destinationId, uint8_t message_type, const uint8_t *payload, uint16_t length);
+    void processFragmentTx();
+    void completeFragmentTx(ROKOR_Mesh_TxStatus status);
+    void handleFragment(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length);
+    void handleFragmentStatus(uint8_t sender_id, const uint8_t *frame, uint16_t frame_length);
+    ReassemblySlot *allocateReassembly(uint8_t sender_id, uint8_t msg_id, uint8_t frag_count);
+    void sendFragmentStatus(const ReassemblySlot &slot);
+
+    void sendGatewayAnnounce(const uint8_t *target_mac = nullptr); // nullptr - широковещательно
+    void startAnnounceTrickle();
+    void resetAnnounceTrickle(); // Изменение в сети: следующее объявление скоро
+    void scheduleGatewayAnnounce();
+    void sendNodeIdRequest();
+    void sendNodeIdAck();
+
+    // Ответы шлюза на GATEWAY_SOLICIT, отложенные на случайное время
+    struct SolicitReply
+    {
+        uint8_t mac[ESP_NOW_ETH_ALEN];
+        uint32_t due_time;
+        bool pending;
+    };
+    static const uint8_t SOLICIT_REPLY_SLOTS = 4;
+    SolicitReply _solicit_replies[SOLICIT_REPLY_SLOTS];
+    void sendGatewaySolicit();
+    void sendLivenessBeacon();
+    void sendGatewayClaim();
+    // true, если кандидат (шлюз) с этим приоритетом и MAC выигрывает выборы у этого устройства
+    bool outranksMe(uint8_t priority, const uint8_t mac[6]) const;
+    void stepDownToNode(uint8_t gateway_id, const uint8_t gateway_mac[6]);
+    void queueSolicitReply(const uint8_t mac[6]);
+    void processSolicitReplies();
+
+    // Резервный шлюз. Шлюз шлет ему GATEWAY_SYNC: снимок таблицы узлов частями, затем ее изменения
+    // (записи [ID][MAC], нулевой MAC - узел удален) и пустые кадры-пульс. Кадр с данными получает
+    // следующий номер, пульс повторяет последний; при пропуске номера резерв запрашивает новый снимок.
+    static const uint8_t STANDBY_SYNC_FLAG_SNAPSHOT_START = 0x01;
+    static const uint8_t STANDBY_SYNC_FLAG_SNAPSHOT_END = 0x02;
+    static const uint8_t STANDBY_HELLO_FLAG_PROBE = 0x01; // Резерв не слышит пульс: шлюз отвечает пульсом сразу
+    static const uint8_t STANDBY_SYNC_MAX_RECORDS = (ROKOR_MESH_MAX_PAYLOAD_SIZE - 3) / LEASE_RECORD_LEN;
+    // Шлюз
+    bool _standby_present;
+    uint8_t _standby_mac[ESP_NOW_ETH_ALEN];
+    uint32_t _standby_last_heard;
+    uint32_t _standby_last_sync_sent;
+    uint8_t _standby_tx_seq;
+    uint8_t _standby_snapshot_cursor; // Следующий слот снимка; NODE_SLOT_NONE - снимок не передается
+    uint8_t _standby_pending[STANDBY_SYNC_MAX_RECORDS * LEASE_RECORD_LEN];
+    uint8_t _standby_pending_count;
+    // Резерв
+    bool _standby_synced;  // Таблица совпадает с таблицей шлюза на момент кадра _standby_rx_seq
+    bool _standby_loading; // Принимается снимок
+    uint8_t _standby_rx_seq;
+    uint32_t _standby_last_sync_rx;
+    uint32_t _standby_last_hello;
+    uint8_t _standby_probes_sent; // Запросы шлюзу без ответа после пропажи пульса
+    void queueStandbyChange(uint8_t node_id, const uint8_t *mac); // mac == nullptr - узел удален
+    void handleStandbyHello(const uint8_t *payload, uint16_t length);
+    void processStandbySync();
+    void enterStandby();
+    void sendStandbyHello(bool probe = false);
+    void handleGatewaySync(const uint8_t *payload, uint16_t length);
+    void takeOverAsGateway();
+
+    bool espNowInit();
     void espNowDeinit();
     static void _esp_now_on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status);
     static void _esp_now_on_data_recv(const esp_now_recv_info_t *recv_info, const uint8_t *incoming_data, int len); // Обновленный esp_now_recv_cb
-    void addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool encrypt);
+
+    // Кольцо приема без блокировок: пишет только _esp_now_on_data_recv(), читает только update()
+    struct RxFrame
+    {
+        uint8_t src_mac[ESP_NOW_ETH_ALEN];
+        uint8_t length;
+        uint32_t rx_time_us;
+        uint8_t data[ESP_NOW_MAX_DATA_LEN];
+    };
+    RxFrame _rx_ring[ROKOR_MESH_RX_RING_SIZE];
+    uint16_t _rx_ring_head;
+    uint16_t _rx_ring_tail;
+    uint32_t _rx_overflow_count;
+    uint32_t _rx_unknown_frame_count;
+    uint32_t _rx_frame_time_us; // Время приема разбираемого кадра
+
+    void resetRxRing();
+    void drainRxRing();
+
+    // Пакет сообщений для setBatchReceiveCallback(), копии данных лежат в _rx_batch_buffer
+    ROKOR_Mesh_RxRecord _rx_batch[ROKOR_MESH_RX_BATCH_SIZE];
+    uint8_t _rx_batch_buffer[ROKOR_MESH_RX_BATCH_BUFFER_SIZE];
+    uint8_t _rx_batch_count;
+    uint16_t _rx_batch_used;
+
+    void collectRxRecord(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length, uint32_t rx_time_us);
+    void flushRxBatch();
+
+    bool _non_blocking_update;
+    SemaphoreHandle_t _activity_signal;
+    TaskHandle_t _activity_notify_task;
+
+    void signalActivity();
+
+    // Задача сети и очередь событий для callback-ов приложения
+    enum class MeshEventType : uint8_t
+    {
+        RECEIVE,
+        TX_COMPLETE,
+        GATEWAY_STATUS,
+        NODE_STATUS,
+        MULTICAST_ACK
+    };
+    struct MeshEvent
+    {
+        MeshEventType type;
+        uint8_t id; // Отправитель, адресат или узел
+        uint8_t message_type;
+        bool connected;
+        ROKOR_Mesh_TxStatus status;
+        ROKOR_Mesh_TxHandle handle;
+        uint16_t length;
+        uint32_t rx_time_us;
+        uint8_t *heap_data; // Сообщение длиннее data (собранное из фрагментов), освобождается после доставки
+        uint8_t data[ROKOR_MESH_MAX_PAYLOAD_SIZE];
+    };
+    bool _mesh_task_enabled;
+    BaseType_t _mesh_task_core;
+    UBaseType_t _mesh_task_priority;
+    uint32_t _mesh_task_stack_size;
+    TaskHandle_t _mesh_task_handle;
+    volatile bool _mesh_task_running;
+    volatile bool _mesh_task_stop;
+    QueueHandle_t _event_queue;
+    std::atomic<uint32_t> _event_overflow_count; // Растет в задаче сети, читается из задачи приложения
+
+    static void _meshTaskEntry(void *arg);
+    void runMeshCycle();
+    void startMeshTask();
+    void stopMeshTask();
+    void emitEvent(MeshEvent &event);
+    void dispatchEvents();
+    void deliverEvent(MeshEvent &event);
+    void notifyGatewayStatus(bool connected);
+    void notifyNodeStatus(uint8_t node_id, bool connected);
+    void notifyTxComplete(ROKOR_Mesh_TxHandle handle, uint8_t destination_id, ROKOR_Mesh_TxStatus status);
+    void notifyMulticastAck(ROKOR_Mesh_TxHandle handle, uint8_t node_id);
+    void invokeReceiveCallback(uint8_t sender_id, uint8_t message_type, const uint8_t *payload, uint16_t length, uint32_t rx_time_us);
+    esp_err_t addEspNowPeer(const uint8_t *mac_address, uint8_t channel, bool encrypt);
+
+    // Кэш пиров ESP-NOW: аппаратная таблица пиров меньше таблицы узлов шлюза, поэтому пир регистрируется
+    // перед отправкой (selectPeer), а при нехватке места вытесняется давно не использованный (LRU)
+    struct PeerCacheEntry
+    {
+        uint8_t mac[ESP_NOW_ETH_ALEN];
+        bool used;
+        uint32_t last_use; // Значение _peer_cache_clock при последней отправке
+    };
+    PeerCacheEntry _peer_cache[ROKOR_MESH_PEER_CACHE_SIZE];
+    uint32_t _peer_cache_clock;
+    ROKOR_Mesh_PeerCacheStats _peer_cache_stats; // peers и capacity считаются в getPeerCacheStats()
+
+    void initPeerCache();
+    uint8_t peerCacheCapacity() const;
+    int evictLruPeer();
+    bool ensurePeer(const uint8_t mac[6]);
+    void selectPeer(const uint8_t mac[6]); // Регистрирует пира при необходимости и делает его адресатом PJON
+    void releasePeer(const uint8_t mac[6]);
 
     enum class MeshDiscoveryMessage : uint8_t
     {
-        GATEWAY_ANNOUNCE = 0xD1,
+        GATEWAY_ANNOUNCE = 0xD1, // [MAC][приоритет][версия протокола]
         NODE_ID_REQUEST = 0xD2,
         NODE_ID_ASSIGN = 0xD3,
         NODE_ID_ACK = 0xD4,
-        NODE_PING_GATEWAY = 0xD5,
-        GATEWAY_PONG_NODE = 0xD6
+        NODE_PING_GATEWAY = 0xD5, // [flags]: PING_FLAG_REPLY - нужен GATEWAY_PONG_NODE (кадр без flags - тоже)
+        GATEWAY_PONG_NODE = 0xD6,
+        BATCH = 0xD7,         // [len][тип][данные][len][тип][данные]... (len учитывает байт типа)
+        MULTICAST = 0xD8,     // [flags][seq][first_id][bitmap_len][bitmap][кадр APP_MESSAGE]
+        MULTICAST_ACK = 0xD9, // [seq]
+        FRAGMENT = 0xDA,        // [msg_id][index][count][flags][данные]
+        FRAGMENT_STATUS = 0xDB, // [msg_id][bitmap_len][битовая карта принятых фрагментов]
+        DATA = 0xDC,            // Одноадресное сообщение из очереди: [flags][seq_lo][seq_hi][кадр APP_MESSAGE или BATCH]
+        STREAM_ACK = 0xDD,      // [highest_lo][highest_hi][bitmap (4 байта, LE)]
+        APP_MESSAGE = 0xDE,     // Сообщение приложения: [тип][данные]
+        GATEWAY_SOLICIT = 0xDF, // Узел ищет шлюз: [MAC узла]; шлюз отвечает GATEWAY_ANNOUNCE на этот MAC
+        GATEWAY_CLAIM = 0xE0,   // Кандидат в шлюзы на выборах: [MAC][приоритет][версия протокола]
+        STANDBY_HELLO = 0xE1,   // Резерв -> шлюз: [MAC резерва][synced][последний номер GATEWAY_SYNC][flags]
+        GATEWAY_SYNC = 0xE2,    // Шлюз -> резерв: [flags][номер][записи [ID][MAC]...]
+        LIVENESS_BEACON = 0xE3  // [номер][период, мс (LE)][bitmap_len][битовая карта ID, зарегистрированных в таблице шлюза]
     };
 };
 